@@ -0,0 +1,93 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// heap allocation made once an arena's base is full (the memory follows the
+// header at the next aligned address)
+typedef struct arena_block_t {
+  struct arena_block_t* next;
+} arena_block_t;
+
+static size_t align_size(const size_t size) {
+  return (size + ArenaAlignment - 1) & ~(size_t)(ArenaAlignment - 1);
+}
+
+static void record_high_water_mark(arena_t* const arena) {
+  const size_t allocated = arena->used + arena->overflow_used;
+  if (allocated > arena->high_water_mark) {
+    arena->high_water_mark = allocated;
+  }
+}
+
+void create_arena(arena_t* const arena, const size_t capacity) {
+  *arena = (arena_t){0};
+  if (capacity > 0) {
+    arena->base = malloc(align_size(capacity));
+    arena->capacity = arena->base != NULL ? align_size(capacity) : 0;
+  }
+}
+
+static void free_overflow(arena_t* const arena) {
+  for (arena_block_t* block = arena->overflow; block != NULL;) {
+    arena_block_t* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->overflow = NULL;
+  arena->overflow_used = 0;
+}
+
+void destroy_arena(arena_t* const arena) {
+  free_overflow(arena);
+  free(arena->base);
+  *arena = (arena_t){0};
+}
+
+void* arena_allocate(arena_t* const arena, const size_t size) {
+  const size_t offset = align_size(arena->used);
+  if (offset + size <= arena->capacity) {
+    arena->used = offset + size;
+    record_high_water_mark(arena);
+    return arena->base + offset;
+  }
+  arena_block_t* block = malloc(align_size(sizeof(arena_block_t)) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->next = arena->overflow;
+  arena->overflow = block;
+  // counted as if allocated from base, as it will be after the next reset
+  arena->overflow_used += align_size(size);
+  record_high_water_mark(arena);
+  return (unsigned char*)block + align_size(sizeof(arena_block_t));
+}
+
+bool arena_extend(
+  arena_t* const arena,
+  void* const memory,
+  const size_t size,
+  const size_t new_size) {
+  const uintptr_t base = (uintptr_t)arena->base;
+  const uintptr_t begin = (uintptr_t)memory;
+  if (
+    arena->base == NULL || begin < base || begin + size != base + arena->used
+    || (size_t)(begin - base) + new_size > arena->capacity) {
+    return false;
+  }
+  arena->used = (size_t)(begin - base) + new_size;
+  record_high_water_mark(arena);
+  return true;
+}
+
+void reset_arena(arena_t* const arena) {
+  free_overflow(arena);
+  arena->used = 0;
+  // grow to fit the most ever allocated so steady state use makes no heap
+  // calls
+  if (arena->high_water_mark > arena->capacity) {
+    free(arena->base);
+    arena->base = malloc(arena->high_water_mark);
+    arena->capacity = arena->base != NULL ? arena->high_water_mark : 0;
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// alignment of every allocation
+#define ArenaAlignment 16
+
+struct arena_block_t;
+
+// linear allocator whose allocations are all freed at once by a reset
+typedef struct arena_t {
+  unsigned char* base;
+  size_t capacity;
+  size_t used; // bytes of base allocated
+  // allocations that didn't fit in base are made from the heap until the
+  // next reset (which grows base to the high-water mark so they then fit)
+  struct arena_block_t* overflow;
+  size_t overflow_used;
+  size_t high_water_mark; // most bytes allocated between any two resets
+} arena_t;
+
+// a zeroed arena is also valid (it grows to fit on its first reset)
+void create_arena(arena_t* arena, size_t capacity);
+void destroy_arena(arena_t* arena);
+
+// uninitialized memory valid until the next reset
+void* arena_allocate(arena_t* arena, size_t size);
+// grow the last allocation in place, false if it isn't the last or there is
+// no room for it to grow
+bool arena_extend(arena_t* arena, void* memory, size_t size, size_t new_size);
+// free every allocation
+void reset_arena(arena_t* arena);
+
+#endif // ARENA_H
@@ -1,7 +1,10 @@
 #include "array.h"
 
+#include "arena.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define ARRAY_RAW_DATA(array) ((int*)(array)-2)
 #define ARRAY_CAPACITY(array) (ARRAY_RAW_DATA(array)[0])
@@ -30,10 +33,53 @@ void* array_hold(void* array, const int count, const int item_size) {
   }
 }
 
+void* array_hold_arena(
+  void* array, const int count, const int item_size, arena_t* const arena) {
+  if (array != NULL && ARRAY_OCCUPIED(array) + count <= ARRAY_CAPACITY(array)) {
+    ARRAY_OCCUPIED(array) += count;
+    return array;
+  }
+  const int occupied = array_length(array) + count;
+  const int doubled = array != NULL ? ARRAY_CAPACITY(array) * 2 : 0;
+  const int capacity = occupied > doubled ? occupied : doubled;
+  const size_t raw_size = sizeof(int) * 2 + (size_t)item_size * capacity;
+  // the most recent allocation can usually grow where it is
+  if (
+    array != NULL
+    && arena_extend(
+      arena,
+      ARRAY_RAW_DATA(array),
+      sizeof(int) * 2 + (size_t)item_size * ARRAY_CAPACITY(array),
+      raw_size)) {
+    ARRAY_CAPACITY(array) = capacity;
+    ARRAY_OCCUPIED(array) = occupied;
+    return array;
+  }
+  int* base = (int*)arena_allocate(arena, raw_size);
+  if (array != NULL) {
+    memcpy(base + 2, array, (size_t)item_size * ARRAY_OCCUPIED(array));
+  }
+  base[0] = capacity;
+  base[1] = occupied;
+  return base + 2;
+}
+
 int array_length(void* array) {
   return (array != NULL) ? (ARRAY_OCCUPIED(array)) : 0;
 }
 
+void array_clear(void* array) {
+  if (array != NULL) {
+    ARRAY_OCCUPIED(array) = 0;
+  }
+}
+
+void array_pop(void* array) {
+  if (array != NULL && ARRAY_OCCUPIED(array) > 0) {
+    ARRAY_OCCUPIED(array)--;
+  }
+}
+
 void array_free(void* array) {
   if (array != NULL) {
     free(ARRAY_RAW_DATA(array));
@@ -7,8 +7,25 @@
     (array)[array_length(array) - 1] = (value);                                \
   } while (0);
 
+// push onto an array held in an arena
+#define array_push_arena(array, value, arena)                                  \
+  do {                                                                         \
+    (array) = array_hold_arena((array), 1, sizeof(*(array)), (arena));         \
+    (array)[array_length(array) - 1] = (value);                                \
+  } while (0);
+
+struct arena_t;
+
 void* array_hold(void* array, int count, int item_size);
+// array_hold growing inside an arena (the array is freed when the arena is
+// reset and must never be passed to array_hold or array_free)
+void* array_hold_arena(
+  void* array, int count, int item_size, struct arena_t* arena);
 int array_length(void* array);
+// remove all items (keeping the capacity)
+void array_clear(void* array);
+// remove the last item
+void array_pop(void* array);
 void array_free(void* array);
 
 #endif // ARRAY_H
@@ -0,0 +1,281 @@
+#include "assets.h"
+
+#include "array.h"
+#include "jobs.h"
+
+#include <SDL.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum asset_type_e { asset_type_mesh, asset_type_texture } asset_type_e;
+
+// a mesh or texture shared by every model loaded from the same path
+typedef struct asset_t {
+  asset_type_e type;
+  char* path;
+  int references;
+  bool loaded; // false while the first thread to request it is loading it
+  mesh_t mesh;
+  texture_t texture;
+} asset_t;
+
+typedef struct pending_request_t {
+  int id;
+  model_request_t request; // paths are owned copies
+} pending_request_t;
+
+// models are handed to the main thread through a lock-free list
+typedef struct loaded_model_t {
+  int request_id;
+  model_t model;
+  struct loaded_model_t* next;
+} loaded_model_t;
+
+static SDL_Thread* s_loader = NULL;
+static SDL_mutex* s_mutex = NULL; // guards everything below but the lists
+static SDL_cond* s_requests_available = NULL;
+static SDL_cond* s_asset_loaded = NULL;
+static SDL_cond* s_model_loaded = NULL;
+static pending_request_t* s_requests = NULL; // array (waiting to be started)
+static asset_t** s_assets = NULL; // array
+static int s_request_count = 0;
+static int s_loaded_count = 0;
+static bool s_quit = false;
+// loaded models pushed by loading threads (most recent first)
+static void* s_pushed_models = NULL;
+// models taken off the pushed list by the main thread (oldest first)
+static loaded_model_t* s_taken_models = NULL;
+
+static char* copy_string(const char* const string) {
+  const size_t size = strlen(string) + 1;
+  char* copy = malloc(size);
+  memcpy(copy, string, size);
+  return copy;
+}
+
+// (mutex must be held)
+static asset_t* find_asset(const asset_type_e type, const char* const path) {
+  for (int a = 0, asset_count = array_length(s_assets); a < asset_count; ++a) {
+    if (s_assets[a]->type == type && strcmp(s_assets[a]->path, path) == 0) {
+      return s_assets[a];
+    }
+  }
+  return NULL;
+}
+
+// the asset at path with a reference added, loading it if this is the first
+// request for it (or waiting if another thread is still loading it)
+static const asset_t* acquire_asset(
+  const asset_type_e type,
+  const char* const path,
+  const model_request_t* const request) {
+  SDL_LockMutex(s_mutex);
+  asset_t* asset = find_asset(type, path);
+  if (asset != NULL) {
+    asset->references++;
+    while (!asset->loaded) {
+      SDL_CondWait(s_asset_loaded, s_mutex);
+    }
+    SDL_UnlockMutex(s_mutex);
+    return asset;
+  }
+  asset = malloc(sizeof *asset);
+  *asset = (asset_t){.type = type, .path = copy_string(path), .references = 1};
+  array_push(s_assets, asset);
+  SDL_UnlockMutex(s_mutex);
+
+  if (type == asset_type_mesh) {
+    asset->mesh = load_obj_mesh(path).mesh;
+  } else {
+    asset->texture = load_png_texture(path);
+    set_texture_sampling(
+      &asset->texture, request->texture_address, request->texture_filter);
+  }
+
+  SDL_LockMutex(s_mutex);
+  asset->loaded = true;
+  SDL_CondBroadcast(s_asset_loaded);
+  SDL_UnlockMutex(s_mutex);
+  return asset;
+}
+
+// drop a reference to the asset, freeing it once it is unused (mutex must be
+// held)
+static void release_asset(asset_t* const asset) {
+  if (asset == NULL || --asset->references > 0) {
+    return;
+  }
+  for (int a = 0, asset_count = array_length(s_assets); a < asset_count; ++a) {
+    if (s_assets[a] == asset) {
+      s_assets[a] = s_assets[asset_count - 1];
+      array_pop(s_assets);
+      break;
+    }
+  }
+  destroy_mesh(&asset->mesh);
+  destroy_texture(&asset->texture);
+  free(asset->path);
+  free(asset);
+}
+
+static void push_loaded_model(loaded_model_t* const loaded) {
+  do {
+    loaded->next = SDL_AtomicGetPtr(&s_pushed_models);
+  } while (!SDL_AtomicCASPtr(&s_pushed_models, loaded->next, loaded));
+
+  SDL_LockMutex(s_mutex);
+  s_loaded_count++;
+  SDL_CondBroadcast(s_model_loaded);
+  SDL_UnlockMutex(s_mutex);
+}
+
+static void load_model(const int index, void* const user_data) {
+  const pending_request_t* pending =
+    &((const pending_request_t*)user_data)[index];
+  const model_request_t* request = &pending->request;
+  loaded_model_t* loaded = malloc(sizeof *loaded);
+  loaded->request_id = pending->id;
+  loaded->model = request->model;
+  loaded->model.mesh =
+    acquire_asset(asset_type_mesh, request->mesh_path, request)->mesh;
+  loaded->model.texture =
+    acquire_asset(asset_type_texture, request->texture_path, request)->texture;
+  push_loaded_model(loaded);
+}
+
+static int run_asset_loader(void* const data) {
+  SDL_LockMutex(s_mutex);
+  for (;;) {
+    pending_request_t* requests = s_requests;
+    if (requests == NULL) {
+      if (s_quit) {
+        break;
+      }
+      SDL_CondWait(s_requests_available, s_mutex);
+      continue;
+    }
+    s_requests = NULL;
+    SDL_UnlockMutex(s_mutex);
+
+    // models requested together are loaded in parallel (as are the chunks
+    // of each obj file)
+    const int request_count = array_length(requests);
+    run_jobs(request_count, load_model, requests);
+    for (int r = 0; r < request_count; ++r) {
+      free((char*)requests[r].request.mesh_path);
+      free((char*)requests[r].request.texture_path);
+    }
+    array_free(requests);
+
+    SDL_LockMutex(s_mutex);
+  }
+  SDL_UnlockMutex(s_mutex);
+  return 0;
+}
+
+void create_asset_loader(void) {
+  s_quit = false;
+  s_mutex = SDL_CreateMutex();
+  s_requests_available = SDL_CreateCond();
+  s_asset_loaded = SDL_CreateCond();
+  s_model_loaded = SDL_CreateCond();
+  s_loader = SDL_CreateThread(run_asset_loader, "asset loader", NULL);
+}
+
+void destroy_asset_loader(void) {
+  SDL_LockMutex(s_mutex);
+  s_quit = true;
+  SDL_CondBroadcast(s_requests_available);
+  SDL_UnlockMutex(s_mutex);
+  SDL_WaitThread(s_loader, NULL);
+  s_loader = NULL;
+
+  // models never taken by the main thread
+  int request_id;
+  model_t model;
+  while (take_loaded_model(&request_id, &model)) {
+    release_model(&model);
+  }
+  // assets that failed to load can't be released by a model
+  for (int a = 0, asset_count = array_length(s_assets); a < asset_count; ++a) {
+    destroy_mesh(&s_assets[a]->mesh);
+    destroy_texture(&s_assets[a]->texture);
+    free(s_assets[a]->path);
+    free(s_assets[a]);
+  }
+  array_free(s_assets);
+  s_assets = NULL;
+  s_request_count = 0;
+  s_loaded_count = 0;
+
+  SDL_DestroyCond(s_model_loaded);
+  SDL_DestroyCond(s_asset_loaded);
+  SDL_DestroyCond(s_requests_available);
+  SDL_DestroyMutex(s_mutex);
+}
+
+int request_model(const model_request_t* const request) {
+  pending_request_t pending = {.request = *request};
+  pending.request.mesh_path = copy_string(request->mesh_path);
+  pending.request.texture_path = copy_string(request->texture_path);
+
+  SDL_LockMutex(s_mutex);
+  pending.id = s_request_count++;
+  array_push(s_requests, pending);
+  SDL_CondSignal(s_requests_available);
+  SDL_UnlockMutex(s_mutex);
+  return pending.id;
+}
+
+bool take_loaded_model(int* const request_id, model_t* const model) {
+  if (s_taken_models == NULL) {
+    // take every model pushed so far and reverse them into the order they
+    // finished loading
+    loaded_model_t* pushed = SDL_AtomicSetPtr(&s_pushed_models, NULL);
+    while (pushed != NULL) {
+      loaded_model_t* next = pushed->next;
+      pushed->next = s_taken_models;
+      s_taken_models = pushed;
+      pushed = next;
+    }
+  }
+  loaded_model_t* loaded = s_taken_models;
+  if (loaded == NULL) {
+    return false;
+  }
+  s_taken_models = loaded->next;
+  *request_id = loaded->request_id;
+  *model = loaded->model;
+  free(loaded);
+  return true;
+}
+
+void wait_for_requested_models(void) {
+  SDL_LockMutex(s_mutex);
+  while (s_loaded_count < s_request_count) {
+    SDL_CondWait(s_model_loaded, s_mutex);
+  }
+  SDL_UnlockMutex(s_mutex);
+}
+
+void release_model(model_t* const model) {
+  SDL_LockMutex(s_mutex);
+  for (int a = array_length(s_assets) - 1; a >= 0; --a) {
+    const asset_t* asset = s_assets[a];
+    const bool used =
+      asset->type == asset_type_mesh
+        ? asset->mesh.vertices != NULL
+            && asset->mesh.vertices == model->mesh.vertices
+        : asset->texture.texels != NULL
+            && asset->texture.texels == model->texture.texels;
+    if (used) {
+      // releasing may move the last asset into this slot, which has already
+      // been checked
+      release_asset(s_assets[a]);
+    }
+  }
+  SDL_UnlockMutex(s_mutex);
+  model->mesh = (mesh_t){0};
+  model->texture = (texture_t){0};
+}
@@ -0,0 +1,37 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "mesh.h"
+#include "texture.h"
+
+#include <stdbool.h>
+
+// a model to load in the background
+typedef struct model_request_t {
+  const char* mesh_path; // obj file
+  const char* texture_path; // png file
+  // sampling used by the texture (the first request for a path decides)
+  texture_address_e texture_address;
+  texture_filter_e texture_filter;
+  model_t model; // placement (the mesh and texture are filled in once loaded)
+} model_request_t;
+
+// start the thread that loads requested models (decoding runs on the job
+// pool so it must already be created)
+void create_asset_loader(void);
+// wait for requests in flight then free every asset still loaded
+void destroy_asset_loader(void);
+
+// queue a model to be loaded, meshes and textures are shared with every other
+// model loaded from the same path (returns the request id, counting up from
+// zero)
+int request_model(const model_request_t* request);
+// next model to finish loading (false if none are ready yet)
+bool take_loaded_model(int* request_id, model_t* model);
+// block until every model requested so far is ready to take
+void wait_for_requested_models(void);
+// drop the model's references to its mesh and texture (freeing them once no
+// other model uses them)
+void release_model(model_t* model);
+
+#endif // ASSETS_H
@@ -0,0 +1,460 @@
+// times each stage of the renderer in isolation (run from the repository root
+// so the assets can be found)
+
+#include "array.h"
+#include "camera.h"
+#include "display.h"
+#include "frustum.h"
+#include "jobs.h"
+#include "mesh.h"
+#include "pipeline.h"
+#include "polygon.h"
+#include "span.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <as-ops.h>
+
+#include <SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// triangles clipped by each iteration of the clipping benchmark
+#define BenchClipTriangleCount 4096
+
+typedef struct bench_options_t {
+  const char* output_path; // NULL to only print results
+  int width;
+  int height;
+  int warmup_count;
+  int iteration_count;
+  int thread_count; // 0 for one thread per cpu core
+  span_kernels_t span_kernels; // name is NULL to use cpu feature detection
+} bench_options_t;
+
+// a stage to time (setup runs untimed before every iteration)
+typedef struct bench_t {
+  const char* name;
+  void (*setup)(void* user_data);
+  void (*run)(void* user_data);
+  void* user_data;
+} bench_t;
+
+typedef struct bench_result_t {
+  const char* name;
+  double min_ms;
+  double median_ms;
+  double p99_ms;
+  double mean_ms;
+} bench_result_t;
+
+// the scene drawn by pikuma
+typedef struct bench_scene_t {
+  pipeline_t pipeline;
+  model_t* models; // array
+  projected_model_t* projected_models; // array
+  as_mat34f view;
+  geometry_stats_t stats;
+} bench_scene_t;
+
+// triangles drawn one after another, each nearer than the last so none are
+// rejected by the depth test
+typedef struct bench_triangles_t {
+  projected_triangle_t* triangles; // array
+  const texture_t* texture; // NULL to fill
+} bench_triangles_t;
+
+typedef struct bench_clip_t {
+  frustum_planes_t frustum_planes;
+  uv_triangle_t* triangles; // array
+} bench_clip_t;
+
+static int compare_doubles(const void* const lhs, const void* const rhs) {
+  const double a = *(const double*)lhs;
+  const double b = *(const double*)rhs;
+  return (a > b) - (a < b);
+}
+
+static bench_result_t run_bench(
+  const bench_t* const bench, const bench_options_t* const options) {
+  for (int w = 0; w < options->warmup_count; ++w) {
+    if (bench->setup != NULL) {
+      bench->setup(bench->user_data);
+    }
+    bench->run(bench->user_data);
+  }
+  double* samples = NULL; // array
+  for (int i = 0; i < options->iteration_count; ++i) {
+    if (bench->setup != NULL) {
+      bench->setup(bench->user_data);
+    }
+    const uint64_t begin_counter = SDL_GetPerformanceCounter();
+    bench->run(bench->user_data);
+    const double seconds =
+      seconds_elapsed(begin_counter, SDL_GetPerformanceCounter());
+    array_push(samples, seconds * 1000.0);
+  }
+  qsort(samples, options->iteration_count, sizeof(double), compare_doubles);
+  double total_ms = 0.0;
+  for (int i = 0; i < options->iteration_count; ++i) {
+    total_ms += samples[i];
+  }
+  const int last = options->iteration_count - 1;
+  const bench_result_t result = {
+    .name = bench->name,
+    .min_ms = samples[0],
+    .median_ms = samples[last / 2],
+    .p99_ms = samples[(int)((double)last * 0.99 + 0.5)],
+    .mean_ms = total_ms / (double)options->iteration_count};
+  array_free(samples);
+  return result;
+}
+
+static void load_mesh(void* const user_data) {
+  model_t model = load_obj_mesh(user_data);
+  destroy_mesh(&model.mesh);
+}
+
+static void parse_mesh(void* const user_data) {
+  mesh_t mesh;
+  if (parse_obj_mesh(user_data, &mesh)) {
+    destroy_mesh(&mesh);
+  }
+}
+
+static void load_texture(void* const user_data) {
+  texture_t texture = load_png_texture(user_data);
+  destroy_texture(&texture);
+}
+
+static void clip_triangles(void* const user_data) {
+  const bench_clip_t* clip = user_data;
+  for (int t = 0, triangle_count = array_length(clip->triangles);
+       t < triangle_count;
+       ++t) {
+    polygon_t polygon = build_polygon_from_uv_triangle(clip->triangles[t]);
+    clip_polygon_against_frustum(
+      &polygon, clip->frustum_planes, FrustumPlaneMask);
+  }
+}
+
+static void process_scene(void* const user_data) {
+  bench_scene_t* scene = user_data;
+  process_graphics_pipeline(
+    &scene->pipeline,
+    scene->models,
+    array_length(scene->models),
+    scene->view,
+    scene->projected_models,
+    &scene->stats);
+}
+
+static void clear_buffers(void* const user_data) {
+  clear_color_buffer(0xff000000);
+  clear_depth_buffer();
+}
+
+// the clears as presenting a frame with nothing drawn sees them
+static void clear_and_resolve_buffers(void* const user_data) {
+  clear_buffers(user_data);
+  resolve_color_clears();
+}
+
+static void draw_triangles(void* const user_data) {
+  const bench_triangles_t* triangles = user_data;
+  for (int t = 0, triangle_count = array_length(triangles->triangles);
+       t < triangle_count;
+       ++t) {
+    if (triangles->texture != NULL) {
+      draw_textured_triangle(triangles->triangles[t], triangles->texture);
+    } else {
+      draw_filled_triangle(
+        triangles->triangles[t], triangles->triangles[t].color);
+    }
+  }
+}
+
+// pseudo random number in [0, 1) (the same sequence every run)
+static float next_random(uint32_t* const state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) / (float)(1 << 24);
+}
+
+// triangles of roughly the given size spread over the screen
+static projected_triangle_t* make_triangles(
+  const int size, const int count, uint32_t* const random_state) {
+  projected_triangle_t* triangles = NULL; // array
+  const int range_x = as_max_int(window_width() - size, 1);
+  const int range_y = as_max_int(window_height() - size, 1);
+  for (int t = 0; t < count; ++t) {
+    const as_point2i origin = {
+      (int)(next_random(random_state) * (float)range_x),
+      (int)(next_random(random_state) * (float)range_y)};
+    const float z = 0.9f - 0.8f * (float)t / (float)count;
+    const projected_triangle_t triangle = {
+      .vertices =
+        {{.point = origin, .z = z, .w = 1.0f, .uv = {0.0f, 0.0f}},
+         {.point = {origin.x + size, origin.y},
+          .z = z,
+          .w = 1.0f,
+          .uv = {1.0f, 0.0f}},
+         {.point = {origin.x, origin.y + size},
+          .z = z,
+          .w = 1.0f,
+          .uv = {0.0f, 1.0f}}},
+      .color = 0xff808080};
+    array_push(triangles, triangle);
+  }
+  return triangles;
+}
+
+static void write_results(
+  const char* const path,
+  const bench_options_t* const options,
+  const bench_result_t* const results,
+  const int result_count) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s for writing.\n", path);
+    return;
+  }
+  fprintf(
+    file,
+    "{\n  \"width\": %d,\n  \"height\": %d,\n  \"threads\": %d,\n"
+    "  \"span_kernels\": \"%s\",\n  \"iterations\": %d,\n"
+    "  \"benchmarks\": [\n",
+    window_width(),
+    window_height(),
+    job_thread_count(),
+    span_kernels_name(),
+    options->iteration_count);
+  for (int r = 0; r < result_count; ++r) {
+    fprintf(
+      file,
+      "    {\"name\": \"%s\", \"min_ms\": %.6f, \"median_ms\": %.6f, "
+      "\"p99_ms\": %.6f, \"mean_ms\": %.6f}%s\n",
+      results[r].name,
+      results[r].min_ms,
+      results[r].median_ms,
+      results[r].p99_ms,
+      results[r].mean_ms,
+      r + 1 < result_count ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  fclose(file);
+}
+
+static void print_usage(const char* program) {
+  fprintf(
+    stderr,
+    "usage: %s [--size <width>x<height>] [--iterations <count>]\n"
+    "          [--warmup <count>] [--threads <count>] [--output <json>]\n"
+    "          [--span-kernels <scalar|sse2|avx2|neon>]\n",
+    program);
+}
+
+static bool parse_options(
+  const int argc, char** argv, bench_options_t* const options) {
+  *options = (bench_options_t){
+    .width = 1920, .height = 1080, .warmup_count = 5, .iteration_count = 50};
+  for (int a = 1; a < argc; ++a) {
+    const bool has_value = a + 1 < argc;
+    if (strcmp(argv[a], "--size") == 0 && has_value) {
+      if (
+        sscanf(argv[++a], "%dx%d", &options->width, &options->height) != 2
+        || options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (strcmp(argv[a], "--iterations") == 0 && has_value) {
+      options->iteration_count = atoi(argv[++a]);
+      if (options->iteration_count <= 0) {
+        return false;
+      }
+    } else if (strcmp(argv[a], "--warmup") == 0 && has_value) {
+      options->warmup_count = atoi(argv[++a]);
+    } else if (strcmp(argv[a], "--threads") == 0 && has_value) {
+      options->thread_count = atoi(argv[++a]);
+    } else if (strcmp(argv[a], "--output") == 0 && has_value) {
+      options->output_path = argv[++a];
+    } else if (strcmp(argv[a], "--span-kernels") == 0 && has_value) {
+      const char* name = argv[++a];
+      if (!find_span_kernels(name, &options->span_kernels)) {
+        fprintf(stderr, "span kernels '%s' are not supported\n", name);
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bench_options_t options;
+  if (!parse_options(argc, argv, &options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (!initialize_headless(options.width, options.height)) {
+    return 1;
+  }
+  if (options.span_kernels.name != NULL) {
+    set_span_kernels(options.span_kernels);
+  }
+  create_job_pool(options.thread_count);
+  create_color_buffer();
+  create_depth_buffer();
+
+  // same scene and starting camera as pikuma
+  const float aspect_ratio = (float)window_width() / (float)window_height();
+  const float vertical_fov = as_radians_from_degrees(60.0f);
+  bench_scene_t scene = {
+    .pipeline = {
+      .perspective_projection =
+        as_mat44f_perspective_projection_depth_zero_to_one_lh(
+          aspect_ratio, vertical_fov, 0.1f, 100.0f),
+      .frustum_planes =
+        build_frustum_planes(aspect_ratio, vertical_fov, 0.1f, 100.0f),
+      .light_direction = {.z = -0.5f, .y = -0.5f},
+      .backface_culling = true}};
+  const char* mesh_paths[] = {
+    "assets/efa.obj", "assets/f22.obj", "assets/f117.obj", "assets/runway.obj"};
+  const char* texture_paths[] = {
+    "assets/efa.png", "assets/f22.png", "assets/f117.png", "assets/runway.png"};
+  const as_vec3f translations[] = {
+    {.x = 2.0f, .y = 0.2f, .z = -18.0f},
+    {.x = -2.0f, .y = 0.2f, .z = -18.0f},
+    {.y = 0.2f, .z = -14.0f},
+    {.y = 0.0f}};
+  for (int m = 0; m < 4; ++m) {
+    model_t model =
+      load_obj_mesh_with_png_texture(mesh_paths[m], texture_paths[m]);
+    model.scale = (as_vec3f){1.0f, 1.0f, 1.0f};
+    model.translation = translations[m];
+    model.rotation = m < 3 ? (as_vec3f){.y = -as_k_pi * 0.5f} : (as_vec3f){0};
+    array_push(scene.models, model);
+    array_push(scene.projected_models, (projected_model_t){0});
+  }
+  set_texture_sampling(
+    &scene.models[3].texture, texture_address_clamp, texture_filter_nearest);
+  const camera_t camera = {
+    .pitch = as_radians_from_degrees(20.0f),
+    .yaw = as_radians_from_degrees(160.0f),
+    .pivot = {.x = -2.0f, .y = 2.5f, .z = -10.0f}};
+  scene.view = camera_view(&camera);
+
+  // view space triangles scattered in and around the frustum
+  bench_clip_t clip = {.frustum_planes = scene.pipeline.frustum_planes};
+  uint32_t random_state = 1;
+  for (int t = 0; t < BenchClipTriangleCount; ++t) {
+    uv_triangle_t triangle = {0};
+    for (int v = 0; v < 3; ++v) {
+      triangle.triangle.vertices[v] = (as_point3f){
+        (next_random(&random_state) - 0.5f) * 40.0f,
+        (next_random(&random_state) - 0.5f) * 40.0f,
+        next_random(&random_state) * 120.0f - 10.0f};
+      triangle.uvs[v] =
+        (tex2f_t){next_random(&random_state), next_random(&random_state)};
+    }
+    array_push(clip.triangles, triangle);
+  }
+
+  const int huge_size = as_max_int(window_width(), window_height()) * 2;
+  bench_triangles_t small_triangles = {
+    .triangles = make_triangles(8, 4096, &random_state)};
+  bench_triangles_t medium_triangles = {
+    .triangles = make_triangles(128, 256, &random_state)};
+  bench_triangles_t huge_triangles = {
+    .triangles = make_triangles(huge_size, 1, &random_state)};
+  bench_triangles_t small_textured = small_triangles;
+  bench_triangles_t medium_textured = medium_triangles;
+  bench_triangles_t huge_textured = huge_triangles;
+  small_textured.texture = &scene.models[1].texture;
+  medium_textured.texture = &scene.models[1].texture;
+  huge_textured.texture = &scene.models[1].texture;
+
+  const bench_t benches[] = {
+    {"load_obj_mesh f22 (cached)", NULL, load_mesh, "assets/f22.obj"},
+    {"parse_obj_mesh f22 (uncached)", NULL, parse_mesh, "assets/f22.obj"},
+    {"load_png_texture f22", NULL, load_texture, "assets/f22.png"},
+    {"clip_polygon_against_frustum x4096", NULL, clip_triangles, &clip},
+    {"process_graphics_pipeline scene", NULL, process_scene, &scene},
+    {"draw_filled_triangle small x4096",
+     clear_buffers,
+     draw_triangles,
+     &small_triangles},
+    {"draw_filled_triangle medium x256",
+     clear_buffers,
+     draw_triangles,
+     &medium_triangles},
+    {"draw_filled_triangle huge",
+     clear_buffers,
+     draw_triangles,
+     &huge_triangles},
+    {"draw_textured_triangle small x4096",
+     clear_buffers,
+     draw_triangles,
+     &small_textured},
+    {"draw_textured_triangle medium x256",
+     clear_buffers,
+     draw_triangles,
+     &medium_textured},
+    {"draw_textured_triangle huge",
+     clear_buffers,
+     draw_triangles,
+     &huge_textured},
+    {"clear buffers", NULL, clear_buffers, NULL},
+    {"clear and resolve buffers", NULL, clear_and_resolve_buffers, NULL}};
+  const int bench_count = sizeof benches / sizeof benches[0];
+
+  fprintf(
+    stdout,
+    "%dx%d, %s spans, %d threads, %d iterations (after %d warm up)\n",
+    window_width(),
+    window_height(),
+    span_kernels_name(),
+    job_thread_count(),
+    options.iteration_count,
+    options.warmup_count);
+  fprintf(
+    stdout,
+    "%-40s %12s %12s %12s\n",
+    "benchmark",
+    "min ms",
+    "median ms",
+    "p99 ms");
+  bench_result_t results[sizeof benches / sizeof benches[0]];
+  for (int b = 0; b < bench_count; ++b) {
+    results[b] = run_bench(&benches[b], &options);
+    fprintf(
+      stdout,
+      "%-40s %12.4f %12.4f %12.4f\n",
+      results[b].name,
+      results[b].min_ms,
+      results[b].median_ms,
+      results[b].p99_ms);
+  }
+  if (options.output_path != NULL) {
+    write_results(options.output_path, &options, results, bench_count);
+  }
+
+  array_free(small_triangles.triangles);
+  array_free(medium_triangles.triangles);
+  array_free(huge_triangles.triangles);
+  array_free(clip.triangles);
+  for (int m = 0, model_count = array_length(scene.models); m < model_count;
+       ++m) {
+    array_free(scene.projected_models[m].projected_triangles);
+    destroy_mesh(&scene.models[m].mesh);
+    destroy_texture(&scene.models[m].texture);
+  }
+  array_free(scene.projected_models);
+  array_free(scene.models);
+  destroy_graphics_pipeline();
+  destroy_job_pool();
+  destroy_depth_buffer();
+  destroy_color_buffer();
+  return 0;
+}
@@ -1,19 +1,76 @@
 #include "display.h"
 
+#include "span.h"
 #include "triangle.h"
 #include <as-ops.h>
 
 #include <SDL.h>
 
+#include <math.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)                                       \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DisplayStreamingStores
+#include <emmintrin.h>
+#endif
+
+// buffers still to be cleared in a tile
+typedef enum tile_clear_e {
+  tile_clear_color = 1 << 0,
+  tile_clear_depth = 1 << 1
+} tile_clear_e;
+
+// pixels drawn in a screen tile
+typedef struct tile_stats_t {
+  uint32_t pixels_tested;
+  uint32_t depth_passed;
+  uint32_t shaded;
+} tile_stats_t;
+
+// heatmap colors for each depth test pass count (the last for any more)
+static const uint32_t OverdrawColors[] = {
+  0xff000000, // black
+  0xff800000, // dark blue
+  0xffff0000, // blue
+  0xffffff00, // cyan
+  0xff00ff00, // green
+  0xff00ffff, // yellow
+  0xff0080ff, // orange
+  0xff0000ff, // red
+  0xffffffff}; // white
+#define OverdrawColorCount (int)(sizeof OverdrawColors / sizeof *OverdrawColors)
 
 // global data
 static struct SDL_Window* s_window = NULL;
 static struct SDL_Renderer* s_renderer = NULL;
+// pixels drawn to (the window texture's while it is locked)
 static uint32_t* s_color_buffer = NULL;
+static int s_color_pitch = 0; // pixels from one row to the next
+// buffer presented by copying it to the window texture (when headless, the
+// renderer is in software or the texture can't be locked)
+static uint32_t* s_color_buffer_copy = NULL;
 static struct SDL_Texture* s_color_buffer_texture = NULL;
 static float* s_depth_buffer = NULL;
+// furthest depth in each screen tile (never nearer than the real furthest
+// depth, it is only brought closer when a triangle covers the whole tile)
+static float* s_tile_depths = NULL;
+// clears are deferred until a tile is first drawn to (or presented)
+static uint8_t* s_tile_clears = NULL;
+static uint32_t s_clear_color = 0;
+static int s_tile_columns = 0;
+static int s_tile_rows = 0;
+// counted per tile (like the tile depths) so bins drawn in parallel never
+// write the same counts
+static bool s_raster_stats = false;
+static tile_stats_t* s_tile_stats = NULL;
+static uint8_t* s_overdraw = NULL; // depth test passes at each pixel
+static span_kernels_t s_span_kernels = {0};
+// offscreen rendering with no window or renderer
+static bool s_headless = false;
 // default/fallback window width/height
 static int s_window_width = 800;
 static int s_window_height = 600;
@@ -70,45 +127,136 @@ bool initialize_window(void) {
   return true;
 }
 
+bool initialize_headless(const int width, const int height) {
+  if (width <= 0 || height <= 0) {
+    fprintf(stderr, "Error invalid headless size %dx%d.\n", width, height);
+    return false;
+  }
+
+  s_headless = true;
+  s_window_width = width;
+  s_window_height = height;
+
+  return true;
+}
+
+bool is_headless(void) {
+  return s_headless;
+}
+
+static void size_tile_grid(void) {
+  s_tile_columns = (s_window_width + TileSize - 1) / TileSize;
+  s_tile_rows = (s_window_height + TileSize - 1) / TileSize;
+}
+
+static uint8_t* tile_clear(const int x, const int y) {
+  return &s_tile_clears[(y / TileSize) * s_tile_columns + x / TileSize];
+}
+
+// apply any clears still pending in the tile containing x, y
+static void resolve_tile_clear(const int x, const int y) {
+  uint8_t* const clear = tile_clear(x, y);
+  if (*clear == 0) {
+    return;
+  }
+  const int begin_x = x & ~(TileSize - 1);
+  const int begin_y = y & ~(TileSize - 1);
+  const int end_x = as_min_int(begin_x + TileSize, s_window_width);
+  const int end_y = as_min_int(begin_y + TileSize, s_window_height);
+  for (int row = begin_y; row < end_y; ++row) {
+    if ((*clear & tile_clear_color) != 0) {
+      uint32_t* colors = &s_color_buffer[row * s_color_pitch];
+      for (int col = begin_x; col < end_x; ++col) {
+        colors[col] = s_clear_color;
+      }
+    }
+    if ((*clear & tile_clear_depth) != 0) {
+      float* depths = &s_depth_buffer[row * s_window_width];
+      for (int col = begin_x; col < end_x; ++col) {
+        depths[col] = 1.0f;
+      }
+    }
+  }
+  *clear = 0;
+}
+
+// fill with non-temporal stores where possible (nothing reads the pixels
+// before they are presented so there is no point pulling them into cache)
+static void stream_fill_colors(
+  uint32_t* const colors, const int count, const uint32_t color) {
+  int col = 0;
+#ifdef DisplayStreamingStores
+  for (; col < count && ((uintptr_t)&colors[col] & 15) != 0; ++col) {
+    colors[col] = color;
+  }
+  const __m128i fill = _mm_set1_epi32((int32_t)color);
+  for (; col + 4 <= count; col += 4) {
+    _mm_stream_si128((__m128i*)&colors[col], fill);
+  }
+#endif
+  for (; col < count; ++col) {
+    colors[col] = color;
+  }
+}
+
+// clear every tile never drawn to, a run of tiles at a time so each row is
+// written contiguously (depth is left pending as it is not presented)
+void resolve_color_clears(void) {
+  for (int tile_row = 0; tile_row < s_tile_rows; ++tile_row) {
+    uint8_t* clears = &s_tile_clears[tile_row * s_tile_columns];
+    for (int first = 0; first < s_tile_columns;) {
+      if ((clears[first] & tile_clear_color) == 0) {
+        first++;
+        continue;
+      }
+      int last = first;
+      for (; last < s_tile_columns && (clears[last] & tile_clear_color) != 0;
+           ++last) {
+        clears[last] &= ~tile_clear_color;
+      }
+      const int begin_x = first * TileSize;
+      const int end_x = as_min_int(last * TileSize, s_window_width);
+      const int begin_y = tile_row * TileSize;
+      const int end_y = as_min_int(begin_y + TileSize, s_window_height);
+      for (int row = begin_y; row < end_y; ++row) {
+        stream_fill_colors(
+          &s_color_buffer[row * s_color_pitch + begin_x],
+          end_x - begin_x,
+          s_clear_color);
+      }
+      first = last;
+    }
+  }
+#ifdef DisplayStreamingStores
+  _mm_sfence();
+#endif
+}
+
 void draw_pixel(const as_point2i point, const uint32_t color) {
   if (
     point.x < 0 || point.x >= s_window_width || point.y <= 0
     || point.y >= s_window_height) {
     return;
   }
-  s_color_buffer[point.y * s_window_width + point.x] = color;
+  resolve_tile_clear(point.x, point.y);
+  s_color_buffer[point.y * s_color_pitch + point.x] = color;
 }
 
 void draw_texel(
   const as_point2i point, const tex2f_t uv, const texture_t texture) {
-  const tex2f_t wrapped_uv = (tex2f_t){
-    uv.u - 1.0f > 0.0f ? fmodf(uv.u, 1.0f) : uv.u,
-    uv.v - 1.0f > 0.0f ? fmodf(uv.v, 1.0f) : uv.v};
-  const tex2f_t clamped_uv = (tex2f_t){
-    as_clamp_float(wrapped_uv.u, 0.0f, 1.0f),
-    as_clamp_float(wrapped_uv.v, 0.0f, 1.0f)};
-  as_point2i texture_coordinate = point2i_at_proportion_of_size2i(
-    (as_size2i){.width = texture.width, .height = texture.height}, clamped_uv);
-  texture_coordinate.x =
-    as_clamp_int(texture_coordinate.x, 0, texture.width - 1);
-  texture_coordinate.y =
-    as_clamp_int(texture_coordinate.y, 0, texture.height - 1);
-  draw_pixel(
-    point,
-    texture.color_buffer
-      [(texture.height - 1 - texture_coordinate.y) * texture.width
-       + texture_coordinate.x]);
+  draw_pixel(point, sample_texture(&texture.levels[0], uv));
 }
 
 void draw_grid(const int spacing, const uint32_t color) {
+  resolve_color_clears();
   for (int grid_col = 0; grid_col < s_window_width; grid_col += spacing) {
     for (int row = 0; row < s_window_height; ++row) {
-      s_color_buffer[row * s_window_width + grid_col] = color;
+      s_color_buffer[row * s_color_pitch + grid_col] = color;
     }
   }
   for (int col = 0; col < s_window_width; ++col) {
     for (int grid_row = 0; grid_row < s_window_height; grid_row += spacing) {
-      s_color_buffer[grid_row * s_window_width + col] = color;
+      s_color_buffer[grid_row * s_color_pitch + col] = color;
     }
   }
 }
@@ -142,253 +290,598 @@ void draw_wire_triangle(
   }
 }
 
-static int compare_projected_vertex(const void* lhs, const void* rhs) {
-  const projected_vertex_t arg1 = *(const projected_vertex_t*)(lhs);
-  const projected_vertex_t arg2 = *(const projected_vertex_t*)(rhs);
-  if (arg1.point.y < arg2.point.y) {
-    return -1;
+// edge function e(x, y) = value + step_x * x + step_y * y, positive inside
+typedef struct edge_t {
+  int value; // value at the origin (0, 0)
+  int step_x; // change in value moving one pixel to the right
+  int step_y; // change in value moving one pixel down
+  int bias; // top-left fill rule adjustment (0 or -1)
+} edge_t;
+
+static edge_t edge_from_points(
+  const as_point2i begin, const as_point2i end, const int orientation) {
+  const as_vec2i edge = as_point2i_sub_point2i(end, begin);
+  const as_vec2i delta = (as_vec2i){edge.x * orientation, edge.y * orientation};
+  // with y pointing down and positive area, top edges run horizontally to the
+  // right and left edges run up the screen
+  const bool top_left = (delta.y == 0 && delta.x > 0) || delta.y < 0;
+  return (edge_t){
+    .value = delta.y * begin.x - delta.x * begin.y,
+    .step_x = -delta.y,
+    .step_y = delta.x,
+    .bias = top_left ? 0 : -1};
+}
+
+static int edge_at(const edge_t edge, const int x, const int y) {
+  return edge.value + edge.step_x * x + edge.step_y * y;
+}
+
+// nearest depths must be at least this far behind a tile's furthest depth
+// for the tile to be skipped (more than the rounding error of interpolating
+// depth per pixel, which tile depths are also padded by)
+#define TileDepthMargin 1e-5f
+
+static float* tile_depth(const int x, const int y) {
+  return &s_tile_depths[(y / TileSize) * s_tile_columns + x / TileSize];
+}
+
+// true if a triangle no nearer than depth may be visible in a tile touching
+// the bounds
+static bool bounds_depth_test(
+  const int min_x,
+  const int min_y,
+  const int max_x,
+  const int max_y,
+  const float depth) {
+  for (int tile_y = min_y & ~(TileSize - 1); tile_y <= max_y;
+       tile_y += TileSize) {
+    for (int tile_x = min_x & ~(TileSize - 1); tile_x <= max_x;
+         tile_x += TileSize) {
+      if (depth - TileDepthMargin < *tile_depth(tile_x, tile_y)) {
+        return true;
+      }
+    }
   }
-  if (arg1.point.y > arg2.point.y) {
-    return 1;
+  return false;
+}
+
+static tile_stats_t* tile_stats(const int x, const int y) {
+  return &s_tile_stats[(y / TileSize) * s_tile_columns + x / TileSize];
+}
+
+// count the pixels in a span with the same tests the kernels make (before
+// they are drawn so the depth buffer is as the kernels see it)
+static void count_span_pixels(
+  const span_t* const span, tile_stats_t* const stats) {
+  uint8_t* const overdraw = &s_overdraw[span->depth_buffer - s_depth_buffer];
+  const int lane_count = s_span_kernels.lane_count;
+  for (int first = 0; first < span->length; first += lane_count) {
+    bool shaded = false;
+    for (int i = first, end = as_min_int(first + lane_count, span->length);
+         i < end;
+         ++i) {
+      const bool covered = ((span->weights[0] + span->weight_steps[0] * i)
+                            | (span->weights[1] + span->weight_steps[1] * i)
+                            | (span->weights[2] + span->weight_steps[2] * i))
+                        >= 0;
+      if (!covered) {
+        continue;
+      }
+      stats->pixels_tested++;
+      const float depth = span->depth + span->depth_step * (float)i;
+      if (depth < span->depth_buffer[i]) {
+        stats->depth_passed++;
+        overdraw[i] += overdraw[i] < UINT8_MAX ? 1 : 0;
+        shaded = true;
+      }
+    }
+    stats->shaded += shaded ? lane_count : 0;
   }
-  return 0;
 }
 
-typedef void (*draw_fn_t)(
-  as_point2i point,
-  projected_vertex_t vert_0,
-  projected_vertex_t vert_1,
-  projected_vertex_t vert_2,
-  barycentric_coords_t barycentric_coords,
-  float w_recip,
-  const void* const user_data);
+static float barycentric_mix(
+  const float a,
+  const float b,
+  const float c,
+  const barycentric_coords_t barycentric_coords) {
+  return a * barycentric_coords.alpha + b * barycentric_coords.beta
+       + c * barycentric_coords.gamma;
+}
 
-static void draw_part_triangle_interpolated(
-  const projected_vertex_t vert_0,
-  const projected_vertex_t vert_1,
-  const projected_vertex_t vert_2,
-  const as_point2i part_begin,
-  const as_point2i part_end,
-  draw_fn_t draw_fn,
+static void draw_triangle_spans(
+  const projected_triangle_t* const triangle,
+  const as_rect clip,
+  span_fn_t span_fn,
   const void* const user_data) {
-  const as_vec2i delta = as_point2i_sub_point2i(part_end, part_begin);
-  float inv_slope_1 = 0.0f;
-  float inv_slope_2 = 0.0f;
-  if (delta.y != 0) {
-    inv_slope_1 = (float)(delta.x) / (float)abs(delta.y);
-  }
-  if (vert_2.point.y - vert_0.point.y != 0) {
-    inv_slope_2 = (float)(vert_2.point.x - vert_0.point.x)
-                / (float)abs(vert_2.point.y - vert_0.point.y);
-  }
-
-  if (delta.y != 0) {
-    for (int y = part_begin.y; y <= part_end.y; y++) {
-      int x_start =
-        vert_1.point.x + (int)((float)(y - vert_1.point.y) * inv_slope_1);
-      int x_end =
-        vert_0.point.x + (int)((float)(y - vert_0.point.y) * inv_slope_2);
-
-      if (x_end < x_start) {
-        as_swap_int(&x_start, &x_end);
+  const projected_vertex_t vert_0 = triangle->vertices[0];
+  const projected_vertex_t vert_1 = triangle->vertices[1];
+  const projected_vertex_t vert_2 = triangle->vertices[2];
+
+  // twice the signed area of the triangle
+  const as_vec2i ab = as_point2i_sub_point2i(vert_1.point, vert_0.point);
+  const as_vec2i ac = as_point2i_sub_point2i(vert_2.point, vert_0.point);
+  const int area = ab.x * ac.y - ab.y * ac.x;
+  if (area == 0) {
+    return;
+  }
+
+  // flip edges of counter-clockwise triangles so inside is always positive
+  const int orientation = area > 0 ? 1 : -1;
+  // edge opposite each vertex (value is proportional to that vertex's weight)
+  const edge_t edges[] = {
+    edge_from_points(vert_1.point, vert_2.point, orientation),
+    edge_from_points(vert_2.point, vert_0.point, orientation),
+    edge_from_points(vert_0.point, vert_1.point, orientation)};
+
+  // spans always start on the same pixels whatever the clip rect (as long as
+  // it is aligned to the tile grid) so clipped triangles match unclipped ones
+  const int min_x = as_max_int(
+    as_min_int(vert_0.point.x, as_min_int(vert_1.point.x, vert_2.point.x)),
+    clip.pos.x);
+  const int min_y = as_max_int(
+    as_min_int(vert_0.point.y, as_min_int(vert_1.point.y, vert_2.point.y)),
+    clip.pos.y);
+  const int max_x = as_min_int(
+    as_max_int(vert_0.point.x, as_max_int(vert_1.point.x, vert_2.point.x)),
+    clip.pos.x + clip.size.width - 1);
+  const int max_y = as_min_int(
+    as_max_int(vert_0.point.y, as_max_int(vert_1.point.y, vert_2.point.y)),
+    clip.pos.y + clip.size.height - 1);
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+
+  // skip triangles behind everything already drawn where they would be
+  const float nearest_depth = fminf(vert_0.z, fminf(vert_1.z, vert_2.z));
+  const float furthest_depth_vertex =
+    fmaxf(vert_0.z, fmaxf(vert_1.z, vert_2.z));
+  if (!bounds_depth_test(min_x, min_y, max_x, max_y, nearest_depth)) {
+    return;
+  }
+
+  // attributes interpolated across the triangle (uvs are divided by w so
+  // they can be interpolated linearly in screen space)
+  const float w_recip_0 = 1.0f / vert_0.w;
+  const float w_recip_1 = 1.0f / vert_1.w;
+  const float w_recip_2 = 1.0f / vert_2.w;
+  const tex2f_t uv_over_w_0 = tex2f_div_scalar(vert_0.uv, vert_0.w);
+  const tex2f_t uv_over_w_1 = tex2f_div_scalar(vert_1.uv, vert_1.w);
+  const tex2f_t uv_over_w_2 = tex2f_div_scalar(vert_2.uv, vert_2.w);
+
+  const float area_recip = 1.0f / (float)(area * orientation);
+  const barycentric_coords_t barycentric_step = {
+    .alpha = (float)edges[0].step_x * area_recip,
+    .beta = (float)edges[1].step_x * area_recip,
+    .gamma = (float)edges[2].step_x * area_recip};
+  // change in depth moving one pixel down
+  const float depth_step_y = barycentric_mix(
+    vert_0.z,
+    vert_1.z,
+    vert_2.z,
+    (barycentric_coords_t){
+      .alpha = (float)edges[0].step_y * area_recip,
+      .beta = (float)edges[1].step_y * area_recip,
+      .gamma = (float)edges[2].step_y * area_recip});
+
+  span_t span = {
+    .depth_step =
+      barycentric_mix(vert_0.z, vert_1.z, vert_2.z, barycentric_step),
+    .w_recip_step =
+      barycentric_mix(w_recip_0, w_recip_1, w_recip_2, barycentric_step),
+    .uv_over_w_step = {
+      .u = barycentric_mix(
+        uv_over_w_0.u, uv_over_w_1.u, uv_over_w_2.u, barycentric_step),
+      .v = barycentric_mix(
+        uv_over_w_0.v, uv_over_w_1.v, uv_over_w_2.v, barycentric_step)}};
+
+  const int tile_extent = TileSize - 1;
+  for (int tile_y = min_y & ~tile_extent; tile_y <= max_y;
+       tile_y += TileSize) {
+    for (int tile_x = min_x & ~tile_extent; tile_x <= max_x;
+         tile_x += TileSize) {
+      // test the tile corner nearest/furthest inside each edge
+      bool reject = false;
+      bool accept = true;
+      for (int e = 0; e < 3; ++e) {
+        const edge_t edge = edges[e];
+        const int corner = edge_at(edge, tile_x, tile_y) + edge.bias;
+        const int x_extent = edge.step_x * tile_extent;
+        const int y_extent = edge.step_y * tile_extent;
+        const int inner =
+          corner + as_max_int(x_extent, 0) + as_max_int(y_extent, 0);
+        const int outer =
+          corner + as_min_int(x_extent, 0) + as_min_int(y_extent, 0);
+        reject |= inner < 0;
+        accept &= outer >= 0;
+      }
+      if (reject) {
+        continue;
+      }
+
+      // nearest depth of the triangle's plane across the tile (but no
+      // nearer than its nearest vertex)
+      const float tile_depth_origin = barycentric_mix(
+        vert_0.z,
+        vert_1.z,
+        vert_2.z,
+        (barycentric_coords_t){
+          .alpha = (float)edge_at(edges[0], tile_x, tile_y) * area_recip,
+          .beta = (float)edge_at(edges[1], tile_x, tile_y) * area_recip,
+          .gamma = (float)edge_at(edges[2], tile_x, tile_y) * area_recip});
+      const float depth_extent_x = span.depth_step * (float)tile_extent;
+      const float depth_extent_y = depth_step_y * (float)tile_extent;
+      const float tile_nearest_depth = fmaxf(
+        nearest_depth,
+        tile_depth_origin + fminf(depth_extent_x, 0.0f)
+          + fminf(depth_extent_y, 0.0f));
+      float* const furthest_depth = tile_depth(tile_x, tile_y);
+      if (tile_nearest_depth - TileDepthMargin >= *furthest_depth) {
+        continue;
       }
+      // a triangle covering the whole tile leaves no depth in it further
+      // than its own furthest depth there
+      if (accept) {
+        const float tile_furthest_depth = fminf(
+          furthest_depth_vertex,
+          tile_depth_origin + fmaxf(depth_extent_x, 0.0f)
+            + fmaxf(depth_extent_y, 0.0f));
+        *furthest_depth =
+          fminf(*furthest_depth, tile_furthest_depth + TileDepthMargin);
+      }
+
+      resolve_tile_clear(tile_x, tile_y);
+      tile_stats_t* const stats =
+        s_raster_stats ? tile_stats(tile_x, tile_y) : NULL;
 
-      for (int x = x_start; x <= x_end; x++) {
-        const as_point2i point = (as_point2i){x, y};
-        const barycentric_coords_t barycentric_coords =
-          calculate_barycentric_coordinates(
-            vert_0.point, vert_1.point, vert_2.point, point);
-        const as_vec3f vec3f_barycentric =
-          vec3f_from_barycentric_coords(barycentric_coords);
-        const float depth = as_vec3f_dot_vec3f(
-          (as_vec3f){vert_0.z, vert_1.z, vert_2.z}, vec3f_barycentric);
-        const int lookup = point.y * s_window_width + point.x;
-        if (
-          lookup < s_window_width * s_window_height
-          && depth < s_depth_buffer[lookup]) {
-          const float w_recip = as_vec3f_dot_vec3f(
-            (as_vec3f){1.0f / vert_0.w, 1.0f / vert_1.w, 1.0f / vert_2.w},
-            vec3f_barycentric);
-          draw_fn(
-            point,
-            vert_0,
-            vert_1,
-            vert_2,
-            barycentric_coords,
-            w_recip,
-            user_data);
-          s_depth_buffer[lookup] = depth;
+      const int begin_x = as_max_int(tile_x, min_x);
+      const int end_x = as_min_int(tile_x + tile_extent, max_x);
+      const int begin_y = as_max_int(tile_y, min_y);
+      const int end_y = as_min_int(tile_y + tile_extent, max_y);
+
+      // trivially accepted tiles use zeroed edges so every pixel passes
+      for (int e = 0; e < 3; ++e) {
+        span.weight_steps[e] = accept ? 0 : edges[e].step_x;
+      }
+      span.length = end_x - begin_x + 1;
+
+      for (int y = begin_y; y <= end_y; ++y) {
+        const int weight_0 = edge_at(edges[0], begin_x, y);
+        const int weight_1 = edge_at(edges[1], begin_x, y);
+        const int weight_2 = edge_at(edges[2], begin_x, y);
+        const barycentric_coords_t barycentric_coords = {
+          .alpha = (float)weight_0 * area_recip,
+          .beta = (float)weight_1 * area_recip,
+          .gamma = (float)weight_2 * area_recip};
+
+        span.color_buffer = &s_color_buffer[y * s_color_pitch + begin_x];
+        span.depth_buffer = &s_depth_buffer[y * s_window_width + begin_x];
+        span.weights[0] = accept ? 0 : weight_0 + edges[0].bias;
+        span.weights[1] = accept ? 0 : weight_1 + edges[1].bias;
+        span.weights[2] = accept ? 0 : weight_2 + edges[2].bias;
+        span.depth =
+          barycentric_mix(vert_0.z, vert_1.z, vert_2.z, barycentric_coords);
+        span.w_recip = barycentric_mix(
+          w_recip_0, w_recip_1, w_recip_2, barycentric_coords);
+        span.uv_over_w = (tex2f_t){
+          .u = barycentric_mix(
+            uv_over_w_0.u, uv_over_w_1.u, uv_over_w_2.u, barycentric_coords),
+          .v = barycentric_mix(
+            uv_over_w_0.v, uv_over_w_1.v, uv_over_w_2.v, barycentric_coords)};
+        if (stats != NULL) {
+          count_span_pixels(&span, stats);
         }
+        span_fn(&span, user_data);
       }
     }
   }
 }
 
-typedef struct filled_triangle_user_data_t {
-  uint32_t color;
-} filled_triangle_user_data_t;
+// change in an attribute moving one pixel right and one pixel down
+static as_vec2f attribute_gradient(
+  const float a,
+  const float b,
+  const float c,
+  const as_vec2i ab,
+  const as_vec2i ac,
+  const float area_recip) {
+  return (as_vec2f){
+    ((b - a) * (float)ac.y - (c - a) * (float)ab.y) * area_recip,
+    ((c - a) * (float)ab.x - (b - a) * (float)ac.x) * area_recip};
+}
 
-static void draw_interpolated_pixel(
-  as_point2i point,
-  projected_vertex_t vert_0,
-  projected_vertex_t vert_1,
-  projected_vertex_t vert_2,
-  barycentric_coords_t barycentric_coords,
-  float w_recip,
-  const void* const user_data) {
-  const filled_triangle_user_data_t* filled_triangle_user_data =
-    (const filled_triangle_user_data_t*)user_data;
-  draw_pixel(point, filled_triangle_user_data->color);
-}
-
-void draw_filled_triangle(projected_triangle_t triangle, const uint32_t color) {
-  // sort vertices (in y axis)
-  qsort(
-    triangle.vertices,
-    sizeof triangle.vertices / sizeof *triangle.vertices,
-    sizeof(projected_vertex_t),
-    compare_projected_vertex);
-
-  filled_triangle_user_data_t filled_triangle_user_data;
-  filled_triangle_user_data.color = color;
-
-  // top
-  draw_part_triangle_interpolated(
-    triangle.vertices[0],
-    triangle.vertices[1],
-    triangle.vertices[2],
-    triangle.vertices[0].point,
-    triangle.vertices[1].point,
-    &draw_interpolated_pixel,
-    &filled_triangle_user_data);
-  // bottom
-  draw_part_triangle_interpolated(
-    triangle.vertices[0],
-    triangle.vertices[1],
-    triangle.vertices[2],
-    triangle.vertices[1].point,
-    triangle.vertices[2].point,
-    &draw_interpolated_pixel,
-    &filled_triangle_user_data);
-}
-
-typedef struct textured_triangle_user_data_t {
-  texture_t texture;
-} textured_triangle_user_data_t;
-
-static void draw_interpolated_texel(
-  as_point2i point,
-  projected_vertex_t vert_0,
-  projected_vertex_t vert_1,
-  projected_vertex_t vert_2,
-  barycentric_coords_t barycentric_coords,
-  float w_recip,
-  const void* const user_data) {
-  const textured_triangle_user_data_t* textured_triangle_user_data =
-    (const textured_triangle_user_data_t*)user_data;
-  const tex2f_t uv = tex2f_div_scalar(
-    calculate_uv(
-      barycentric_coords,
-      vert_0.uv,
-      vert_0.w,
-      vert_1.uv,
-      vert_1.w,
-      vert_2.uv,
-      vert_2.w),
-    w_recip);
-  draw_texel(point, uv, textured_triangle_user_data->texture);
+// mip level for a triangle from its screen space uv derivatives, these are
+// taken at the vertex nearest the camera (where the texture is magnified
+// most) so no part of the triangle is drawn blurrier than its nearest level
+const texture_level_t* select_texture_level(
+  const projected_triangle_t* const triangle, const texture_t* const texture) {
+  const projected_vertex_t* vertices = triangle->vertices;
+  const as_vec2i ab =
+    as_point2i_sub_point2i(vertices[1].point, vertices[0].point);
+  const as_vec2i ac =
+    as_point2i_sub_point2i(vertices[2].point, vertices[0].point);
+  const int area = ab.x * ac.y - ab.y * ac.x;
+  if (area == 0 || texture->level_count <= 1) {
+    return &texture->levels[0];
+  }
+  const float area_recip = 1.0f / (float)area;
+
+  // uv / w and 1 / w are linear in screen space, u = (uv / w) / (1 / w)
+  float w_recips[3];
+  tex2f_t uvs_over_w[3];
+  int nearest = 0;
+  for (int v = 0; v < 3; ++v) {
+    w_recips[v] = 1.0f / vertices[v].w;
+    uvs_over_w[v] = tex2f_div_scalar(vertices[v].uv, vertices[v].w);
+    nearest = w_recips[v] > w_recips[nearest] ? v : nearest;
+  }
+  const as_vec2f w_recip_gradient = attribute_gradient(
+    w_recips[0], w_recips[1], w_recips[2], ab, ac, area_recip);
+  const as_vec2f u_over_w_gradient = attribute_gradient(
+    uvs_over_w[0].u, uvs_over_w[1].u, uvs_over_w[2].u, ab, ac, area_recip);
+  const as_vec2f v_over_w_gradient = attribute_gradient(
+    uvs_over_w[0].v, uvs_over_w[1].v, uvs_over_w[2].v, ab, ac, area_recip);
+
+  // derivative of u = U / W is (dU - u * dW) / W (scaled to level 0 texels)
+  const tex2f_t uv = vertices[nearest].uv;
+  const float w = vertices[nearest].w;
+  const float width = (float)texture->levels[0].width;
+  const float height = (float)texture->levels[0].height;
+  const as_vec2f du = {
+    (u_over_w_gradient.x - uv.u * w_recip_gradient.x) * w * width,
+    (u_over_w_gradient.y - uv.u * w_recip_gradient.y) * w * width};
+  const as_vec2f dv = {
+    (v_over_w_gradient.x - uv.v * w_recip_gradient.x) * w * height,
+    (v_over_w_gradient.y - uv.v * w_recip_gradient.y) * w * height};
+
+  // texels crossed by a step along x or y (squared), each level halves it
+  const float footprint = fmaxf(
+    du.x * du.x + dv.x * dv.x, du.y * du.y + dv.y * dv.y);
+  if (!(footprint > 1.0f)) {
+    return &texture->levels[0];
+  }
+  const int level = (int)floorf(0.5f * log2f(footprint) + 0.5f);
+  return &texture->levels[as_min_int(level, texture->level_count - 1)];
+}
+
+static as_rect screen_rect(void) {
+  return (as_rect){
+    .size = (as_size2i){.width = s_window_width, .height = s_window_height}};
+}
+
+void draw_filled_triangle(
+  const projected_triangle_t triangle, const uint32_t color) {
+  draw_triangle_spans(&triangle, screen_rect(), s_span_kernels.fill, &color);
 }
 
 void draw_textured_triangle(
-  projected_triangle_t triangle, const texture_t texture) {
-  // sort vertices (in y axis)
-  qsort(
-    triangle.vertices,
-    sizeof triangle.vertices / sizeof *triangle.vertices,
-    sizeof(projected_vertex_t),
-    compare_projected_vertex);
-
-  textured_triangle_user_data_t textured_triangle_user_data;
-  textured_triangle_user_data.texture = texture;
-
-  // top
-  draw_part_triangle_interpolated(
-    triangle.vertices[0],
-    triangle.vertices[1],
-    triangle.vertices[2],
-    triangle.vertices[0].point,
-    triangle.vertices[1].point,
-    &draw_interpolated_texel,
-    &textured_triangle_user_data);
-  // bottom
-  draw_part_triangle_interpolated(
-    triangle.vertices[0],
-    triangle.vertices[1],
-    triangle.vertices[2],
-    triangle.vertices[1].point,
-    triangle.vertices[2].point,
-    &draw_interpolated_texel,
-    &textured_triangle_user_data);
+  const projected_triangle_t triangle, const texture_t* const texture) {
+  draw_triangle_spans(
+    &triangle,
+    screen_rect(),
+    s_span_kernels.texture,
+    select_texture_level(&triangle, texture));
+}
+
+void draw_filled_triangle_clipped(
+  const projected_triangle_t* const triangle,
+  const uint32_t color,
+  const as_rect clip) {
+  draw_triangle_spans(triangle, clip, s_span_kernels.fill, &color);
+}
+
+void draw_textured_triangle_clipped(
+  const projected_triangle_t* const triangle,
+  const texture_level_t* const level,
+  const as_rect clip) {
+  draw_triangle_spans(triangle, clip, s_span_kernels.texture, level);
 }
 
 void clear_color_buffer(const uint32_t color) {
-  for (int col = 0; col < s_window_width; ++col) {
-    for (int row = 0; row < s_window_height; ++row) {
-      s_color_buffer[row * s_window_width + col] = color;
-    }
+  s_clear_color = color;
+  for (int tile = 0, tile_count = s_tile_columns * s_tile_rows;
+       tile < tile_count;
+       ++tile) {
+    s_tile_clears[tile] |= tile_clear_color;
   }
 }
 
 void clear_depth_buffer(void) {
-  for (int col = 0; col < s_window_width; ++col) {
-    for (int row = 0; row < s_window_height; ++row) {
-      s_depth_buffer[row * s_window_width + col] = 1.0f;
+  for (int tile = 0, tile_count = s_tile_columns * s_tile_rows;
+       tile < tile_count;
+       ++tile) {
+    s_tile_clears[tile] |= tile_clear_depth;
+    s_tile_depths[tile] = 1.0f;
+  }
+  if (s_raster_stats) {
+    memset(
+      s_tile_stats, 0, sizeof(tile_stats_t) * s_tile_columns * s_tile_rows);
+    memset(s_overdraw, 0, sizeof(uint8_t) * s_window_width * s_window_height);
+  }
+}
+
+void set_raster_stats(const bool enabled) {
+  if (enabled && s_tile_stats == NULL) {
+    s_tile_stats = calloc(s_tile_columns * s_tile_rows, sizeof(tile_stats_t));
+    s_overdraw = calloc(s_window_width * s_window_height, sizeof(uint8_t));
+  }
+  s_raster_stats = enabled;
+}
+
+raster_stats_t raster_stats(void) {
+  raster_stats_t stats = {0};
+  if (s_tile_stats == NULL) {
+    return stats;
+  }
+  for (int tile = 0, tile_count = s_tile_columns * s_tile_rows;
+       tile < tile_count;
+       ++tile) {
+    stats.pixels_tested += s_tile_stats[tile].pixels_tested;
+    stats.depth_passed += s_tile_stats[tile].depth_passed;
+    stats.shaded += s_tile_stats[tile].shaded;
+  }
+  return stats;
+}
+
+void draw_overdraw_heatmap(void) {
+  for (int row = 0; row < s_window_height; ++row) {
+    for (int col = 0; col < s_window_width; ++col) {
+      const int passes = s_overdraw != NULL
+                         ? s_overdraw[row * s_window_width + col]
+                         : 0;
+      s_color_buffer[row * s_color_pitch + col] =
+        OverdrawColors[as_min_int(passes, OverdrawColorCount - 1)];
     }
   }
+  // every pixel has been written so no color clears are left to apply
+  for (int tile = 0, tile_count = s_tile_columns * s_tile_rows;
+       tile < tile_count;
+       ++tile) {
+    s_tile_clears[tile] &= ~tile_clear_color;
+  }
+}
+
+void lock_color_buffer(void) {
+  if (s_color_buffer_copy != NULL) {
+    return;
+  }
+  void* pixels;
+  int pitch;
+  if (SDL_LockTexture(s_color_buffer_texture, NULL, &pixels, &pitch) != 0) {
+    fprintf(stderr, "Error locking texture, presenting with a copy.\n");
+    s_color_buffer_copy =
+      malloc(sizeof(uint32_t) * s_window_width * s_window_height);
+    s_color_buffer = s_color_buffer_copy;
+    s_color_pitch = s_window_width;
+    return;
+  }
+  s_color_buffer = pixels;
+  s_color_pitch = pitch / (int)sizeof(uint32_t);
 }
 
 void render_color_buffer(void) {
-  SDL_UpdateTexture(
-    s_color_buffer_texture,
-    NULL,
-    s_color_buffer,
-    s_window_width * sizeof(uint32_t));
+  if (s_headless) {
+    return;
+  }
+  resolve_color_clears();
+  if (s_color_buffer_copy != NULL) {
+    SDL_UpdateTexture(
+      s_color_buffer_texture,
+      NULL,
+      s_color_buffer_copy,
+      s_window_width * sizeof(uint32_t));
+  } else {
+    SDL_UnlockTexture(s_color_buffer_texture);
+    s_color_buffer = NULL;
+  }
   SDL_RenderCopy(s_renderer, s_color_buffer_texture, NULL, NULL);
 }
 
 void deinitialize_window(void) {
+  if (s_headless) {
+    return;
+  }
   SDL_DestroyRenderer(s_renderer);
   SDL_DestroyWindow(s_window);
   SDL_Quit();
 }
 
 void create_color_buffer(void) {
-  s_color_buffer = malloc(sizeof(uint32_t) * s_window_width * s_window_height);
-  s_color_buffer_texture = SDL_CreateTexture(
-    s_renderer,
-    SDL_PIXELFORMAT_RGBA32,
-    SDL_TEXTUREACCESS_STREAMING,
-    s_window_width,
-    s_window_height);
+  if (s_span_kernels.name == NULL) {
+    s_span_kernels = select_span_kernels();
+  }
+  size_tile_grid();
+  s_tile_clears = calloc(s_tile_columns * s_tile_rows, sizeof(uint8_t));
+  if (!s_headless) {
+    s_color_buffer_texture = SDL_CreateTexture(
+      s_renderer,
+      SDL_PIXELFORMAT_RGBA32,
+      SDL_TEXTUREACCESS_STREAMING,
+      s_window_width,
+      s_window_height);
+    // software renderers keep their own copy of the texture's pixels, so
+    // drawing straight into them saves nothing
+    SDL_RendererInfo renderer_info;
+    if (
+      SDL_GetRendererInfo(s_renderer, &renderer_info) == 0
+      && (renderer_info.flags & SDL_RENDERER_SOFTWARE) == 0) {
+      return;
+    }
+  }
+  s_color_buffer_copy =
+    malloc(sizeof(uint32_t) * s_window_width * s_window_height);
+  s_color_buffer = s_color_buffer_copy;
+  s_color_pitch = s_window_width;
 }
 
 void destroy_color_buffer(void) {
-  SDL_DestroyTexture(s_color_buffer_texture);
-  free(s_color_buffer);
+  if (s_color_buffer_texture != NULL) {
+    SDL_DestroyTexture(s_color_buffer_texture);
+  }
+  free(s_tile_clears);
+  free(s_color_buffer_copy);
+  s_color_buffer_copy = NULL;
+  s_color_buffer = NULL;
 }
 
 void create_depth_buffer(void) {
   s_depth_buffer = malloc(sizeof(float) * s_window_width * s_window_height);
+  size_tile_grid();
+  s_tile_depths = malloc(sizeof(float) * s_tile_columns * s_tile_rows);
 }
 
 void destroy_depth_buffer(void) {
+  free(s_overdraw);
+  s_overdraw = NULL;
+  free(s_tile_stats);
+  s_tile_stats = NULL;
+  s_raster_stats = false;
+  free(s_tile_depths);
   free(s_depth_buffer);
 }
 
 void renderer_present(void) {
+  if (s_headless) {
+    return;
+  }
   SDL_RenderPresent(s_renderer);
 }
 
+bool write_color_buffer_ppm(const char* path) {
+  if (s_color_buffer == NULL) {
+    fprintf(stderr, "Error writing %s, the color buffer is unlocked.\n", path);
+    return false;
+  }
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s for writing.\n", path);
+    return false;
+  }
+
+  resolve_color_clears();
+  fprintf(file, "P6\n%d %d\n255\n", s_window_width, s_window_height);
+  for (int row = 0; row < s_window_height; ++row) {
+    for (int col = 0; col < s_window_width; ++col) {
+      // color buffer is SDL_PIXELFORMAT_RGBA32 (byte order r, g, b, a)
+      const uint32_t color = s_color_buffer[row * s_color_pitch + col];
+      const uint8_t rgb[] = {
+        color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff};
+      fwrite(rgb, sizeof rgb, 1, file);
+    }
+  }
+
+  const bool written = ferror(file) == 0;
+  fclose(file);
+  return written;
+}
+
+void set_span_kernels(const span_kernels_t span_kernels) {
+  s_span_kernels = span_kernels;
+}
+
+const char* span_kernels_name(void) {
+  return s_span_kernels.name;
+}
+
 int window_width(void) {
   return s_window_width;
 }
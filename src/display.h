@@ -4,6 +4,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// size (in pixels) of the square screen tiles the rasterizer walks
+#define TileSize 8
+
+// pixels drawn by the span kernels
+typedef struct raster_stats_t {
+  int64_t pixels_tested; // covered by a triangle and depth tested
+  int64_t depth_passed;
+  int64_t shaded; // every pixel in lane groups the kernels shaded
+} raster_stats_t;
+
 struct SDL_Window;
 struct SDL_Renderer;
 struct SDL_Texture;
@@ -13,7 +23,9 @@ struct as_point2f;
 struct as_point3f;
 struct as_rect;
 struct projected_triangle_t;
+struct span_kernels_t;
 struct tex2f_t;
+struct texture_level_t;
 struct texture_t;
 
 int32_t fps(void);
@@ -21,6 +33,9 @@ float seconds_per_frame(void);
 double seconds_elapsed(uint64_t old_counter, uint64_t current_counter);
 
 bool initialize_window(void);
+// render offscreen at the given size (no window, renderer or frame pacing)
+bool initialize_headless(int width, int height);
+bool is_headless(void);
 void deinitialize_window(void);
 
 void create_color_buffer(void);
@@ -38,13 +53,48 @@ void draw_line(struct as_point2i p0, struct as_point2i p1, uint32_t color);
 void draw_wire_triangle(struct projected_triangle_t triangle, uint32_t color);
 void draw_filled_triangle(struct projected_triangle_t triangle, uint32_t color);
 void draw_textured_triangle(
-  struct projected_triangle_t triangle, struct texture_t texture);
+  struct projected_triangle_t triangle, const struct texture_t* texture);
+// draw only the part of the triangle inside clip (which must be aligned to
+// TileSize so the result is identical to drawing the whole triangle)
+void draw_filled_triangle_clipped(
+  const struct projected_triangle_t* triangle,
+  uint32_t color,
+  struct as_rect clip);
+void draw_textured_triangle_clipped(
+  const struct projected_triangle_t* triangle,
+  const struct texture_level_t* level,
+  struct as_rect clip);
+// mip level with texels closest to the size of the triangle's pixels (picked
+// once per triangle, however many bins it is drawn in)
+const struct texture_level_t* select_texture_level(
+  const struct projected_triangle_t* triangle, const struct texture_t* texture);
 
+// start drawing a frame (straight into the window texture's pixels if it can
+// be locked, otherwise into a buffer copied to it by render_color_buffer)
+void lock_color_buffer(void);
 void render_color_buffer(void);
+// clears only mark tiles, which are cleared when first drawn to (or
+// presented)
 void clear_color_buffer(uint32_t color);
 void clear_depth_buffer(void);
+// clear every tile still marked in the color buffer (called when presenting)
+void resolve_color_clears(void);
+
+// count the pixels drawn and how many times each passes the depth test (an
+// extra pass over every span, so off unless enabled)
+void set_raster_stats(bool enabled);
+// pixels drawn since the depth buffer was cleared (zero unless counting)
+raster_stats_t raster_stats(void);
+// replace the color buffer with a heatmap of the depth test passes counted
+// at each pixel since the depth buffer was cleared
+void draw_overdraw_heatmap(void);
 
 void renderer_present(void);
+bool write_color_buffer_ppm(const char* path);
+
+// override the span kernels picked by cpu feature detection
+void set_span_kernels(struct span_kernels_t span_kernels);
+const char* span_kernels_name(void);
 
 int window_width(void);
 int window_height(void);
@@ -0,0 +1,164 @@
+#include "frames.h"
+
+#include "array.h"
+#include "profile.h"
+
+#include <SDL.h>
+
+// geometry to process for a frame (copied when it is started)
+typedef struct frame_geometry_t {
+  pipeline_t pipeline;
+  const model_t* models;
+  int model_count;
+  as_mat34f view;
+  frame_t* frame;
+} frame_geometry_t;
+
+static frame_t s_frames[FrameMaxPipelineDepth] = {0};
+static int s_next_frame = 0; // frame the next geometry is written to
+static int s_depth = 1;
+static bool s_started = false;
+static frame_geometry_t s_geometry = {0};
+static SDL_Thread* s_geometry_thread = NULL;
+static SDL_mutex* s_mutex = NULL; // guards everything below
+static SDL_cond* s_changed = NULL;
+static bool s_geometry_pending = false; // waiting for or being processed
+static bool s_quit = false;
+
+static void process_frame_geometry(const frame_geometry_t* const geometry) {
+  profile_begin("frame geometry");
+  frame_t* frame = geometry->frame;
+  process_graphics_pipeline(
+    &geometry->pipeline,
+    geometry->models,
+    geometry->model_count,
+    geometry->view,
+    frame->projected_models,
+    &frame->geometry_stats);
+  order_projected_models(
+    &geometry->pipeline,
+    frame->projected_models,
+    geometry->model_count,
+    frame->model_order);
+  frame->model_count = geometry->model_count;
+  profile_end();
+}
+
+static int run_geometry_thread(void* const data) {
+  SDL_LockMutex(s_mutex);
+  for (;;) {
+    if (!s_geometry_pending) {
+      if (s_quit) {
+        break;
+      }
+      SDL_CondWait(s_changed, s_mutex);
+      continue;
+    }
+    SDL_UnlockMutex(s_mutex);
+    process_frame_geometry(&s_geometry);
+    SDL_LockMutex(s_mutex);
+    s_geometry_pending = false;
+    SDL_CondBroadcast(s_changed);
+  }
+  SDL_UnlockMutex(s_mutex);
+  return 0;
+}
+
+void create_frame_pipeline(const int depth) {
+  s_depth = as_max_int(1, as_min_int(depth, FrameMaxPipelineDepth));
+  s_next_frame = 0;
+  s_started = false;
+  if (s_depth == 1) {
+    return;
+  }
+  s_quit = false;
+  s_mutex = SDL_CreateMutex();
+  s_changed = SDL_CreateCond();
+  s_geometry_thread =
+    SDL_CreateThread(run_geometry_thread, "frame geometry", NULL);
+  if (s_geometry_thread == NULL) {
+    SDL_DestroyCond(s_changed);
+    SDL_DestroyMutex(s_mutex);
+    s_depth = 1;
+  }
+}
+
+void destroy_frame_pipeline(void) {
+  if (s_started) {
+    finish_frame_geometry();
+  }
+  if (s_geometry_thread != NULL) {
+    SDL_LockMutex(s_mutex);
+    s_quit = true;
+    SDL_CondBroadcast(s_changed);
+    SDL_UnlockMutex(s_mutex);
+    SDL_WaitThread(s_geometry_thread, NULL);
+    s_geometry_thread = NULL;
+    SDL_DestroyCond(s_changed);
+    SDL_DestroyMutex(s_mutex);
+  }
+  for (int f = 0; f < FrameMaxPipelineDepth; ++f) {
+    frame_t* frame = &s_frames[f];
+    for (int m = 0, model_count = array_length(frame->projected_models);
+         m < model_count;
+         ++m) {
+      array_free(frame->projected_models[m].projected_triangles);
+    }
+    array_free(frame->projected_models);
+    array_free(frame->model_order);
+    *frame = (frame_t){0};
+  }
+}
+
+int frame_pipeline_depth(void) {
+  return s_depth;
+}
+
+void start_frame_geometry(
+  const pipeline_t* const pipeline,
+  const model_t* const models,
+  const int model_count,
+  const as_mat34f view) {
+  frame_t* frame = &s_frames[s_next_frame];
+  s_next_frame = (s_next_frame + 1) % s_depth;
+  while (array_length(frame->projected_models) < model_count) {
+    array_push(frame->projected_models, (projected_model_t){0});
+    array_push(frame->model_order, 0);
+  }
+  const frame_geometry_t geometry = {
+    .pipeline = *pipeline,
+    .models = models,
+    .model_count = model_count,
+    .view = view,
+    .frame = frame};
+  s_started = true;
+
+  if (s_depth == 1) {
+    s_geometry = geometry;
+    process_frame_geometry(&s_geometry);
+    return;
+  }
+  SDL_LockMutex(s_mutex);
+  s_geometry = geometry;
+  s_geometry_pending = true;
+  SDL_CondBroadcast(s_changed);
+  SDL_UnlockMutex(s_mutex);
+}
+
+bool frame_geometry_started(void) {
+  return s_started;
+}
+
+const frame_t* finish_frame_geometry(void) {
+  if (s_depth > 1) {
+    profile_begin("wait for geometry");
+    SDL_LockMutex(s_mutex);
+    while (s_geometry_pending) {
+      SDL_CondWait(s_changed, s_mutex);
+    }
+    SDL_UnlockMutex(s_mutex);
+    profile_end();
+  }
+  s_started = false;
+  return s_geometry.frame;
+}
@@ -0,0 +1,44 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "mesh.h"
+#include "pipeline.h"
+
+#include <as-ops.h>
+
+#include <stdbool.h>
+
+// frames of geometry kept in flight (the next frame's geometry is processed
+// while the current one is rasterized when more than one)
+#define FrameMaxPipelineDepth 2
+
+// geometry processed for one frame
+typedef struct frame_t {
+  projected_model_t* projected_models; // array
+  int* model_order; // array (projected models in drawing order)
+  int model_count;
+  geometry_stats_t geometry_stats;
+} frame_t;
+
+// depth 1 processes geometry on the calling thread when it is started, depth
+// 2 hands it to a geometry thread (geometry runs on the job pool so it must
+// already be created)
+void create_frame_pipeline(int depth);
+// waits for geometry still being processed
+void destroy_frame_pipeline(void);
+int frame_pipeline_depth(void);
+
+// begin processing geometry for the next frame, the pipeline settings are
+// copied but models must be left unchanged until the frame is finished
+void start_frame_geometry(
+  const pipeline_t* pipeline,
+  const model_t* models,
+  int model_count,
+  as_mat34f view);
+// true if geometry has been started and not yet finished
+bool frame_geometry_started(void);
+// wait for the geometry started last (the frame stays valid until the next
+// frame is finished)
+const frame_t* finish_frame_geometry(void);
+
+#endif // FRAMES_H
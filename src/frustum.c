@@ -31,3 +31,36 @@ frustum_planes_t build_frustum_planes(
          .point = (as_point3f){.z = far}},
     }};
 }
+
+int frustum_outcode(
+  const frustum_planes_t* const frustum_planes, const as_point3f point) {
+  int outcode = 0;
+  for (int plane_index = 0; plane_index < FrustumPlaneCount; ++plane_index) {
+    const as_plane plane = frustum_planes->planes[plane_index];
+    const float dot = as_vec3f_dot_vec3f(
+      as_point3f_sub_point3f(point, plane.point), plane.normal);
+    if (!(dot > 0.0f)) {
+      outcode |= 1 << plane_index;
+    }
+  }
+  return outcode;
+}
+
+frustum_containment_e frustum_sphere_containment(
+  const frustum_planes_t* const frustum_planes,
+  const as_point3f center,
+  const float radius) {
+  frustum_containment_e containment = frustum_containment_inside;
+  for (int plane_index = 0; plane_index < FrustumPlaneCount; ++plane_index) {
+    const as_plane plane = frustum_planes->planes[plane_index];
+    const float distance = as_vec3f_dot_vec3f(
+      as_point3f_sub_point3f(center, plane.point), plane.normal);
+    if (distance <= -radius) {
+      return frustum_containment_outside;
+    }
+    if (distance <= radius) {
+      containment = frustum_containment_crossing;
+    }
+  }
+  return containment;
+}
@@ -4,6 +4,8 @@
 #include <as-ops.h>
 
 #define FrustumPlaneCount 6
+// mask with a bit set for every frustum plane
+#define FrustumPlaneMask ((1 << FrustumPlaneCount) - 1)
 
 typedef enum frustum_plane_e {
   frustum_plane_left,
@@ -21,4 +23,18 @@ typedef struct frustum_planes_t {
 frustum_planes_t build_frustum_planes(
   float aspect_ratio, float vertical_fov, float near, float far);
 
+typedef enum frustum_containment_e {
+  frustum_containment_outside,
+  frustum_containment_crossing,
+  frustum_containment_inside
+} frustum_containment_e;
+
+// bit (1 << frustum_plane_e) set for each plane the point is outside of
+// (points on a plane count as outside to match the polygon clipper)
+int frustum_outcode(const frustum_planes_t* frustum_planes, as_point3f point);
+// sphere against the frustum (inside means inside every plane, outside means
+// fully outside of at least one)
+frustum_containment_e frustum_sphere_containment(
+  const frustum_planes_t* frustum_planes, as_point3f center, float radius);
+
 #endif // FRUSTUM_H
@@ -0,0 +1,193 @@
+#include "jobs.h"
+
+#include "array.h"
+
+#include <SDL.h>
+#include <as-ops.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// indices a thread has still to run, it takes jobs from the front while other
+// threads that have run out of work steal from the back
+typedef struct job_range_t {
+  SDL_SpinLock lock;
+  int begin;
+  int end;
+} job_range_t;
+
+typedef struct job_batch_t {
+  job_fn_t job_fn;
+  void* user_data;
+  // range 0 belongs to the calling thread and range w + 1 to worker w
+  job_range_t ranges[JobMaxThreads];
+  int range_count;
+  SDL_atomic_t unclaimed; // jobs not yet taken by any thread
+  int workers; // worker threads running jobs from the batch (guarded by mutex)
+  struct job_batch_t* next_batch;
+} job_batch_t;
+
+static SDL_Thread** s_workers = NULL; // array
+static SDL_mutex* s_mutex = NULL;
+static SDL_cond* s_work_available = NULL;
+static SDL_cond* s_worker_finished = NULL;
+static job_batch_t* s_batches = NULL; // batches currently being run
+static bool s_quit = false;
+
+static bool claim_job(job_range_t* const range, int* const index) {
+  SDL_AtomicLock(&range->lock);
+  const bool claimed = range->begin < range->end;
+  if (claimed) {
+    *index = range->begin++;
+  }
+  SDL_AtomicUnlock(&range->lock);
+  return claimed;
+}
+
+// move the back half of another thread's range into the (empty) thief range
+static bool steal_jobs(job_batch_t* const batch, const int thief) {
+  for (int offset = 1; offset < batch->range_count; ++offset) {
+    job_range_t* victim =
+      &batch->ranges[(thief + offset) % batch->range_count];
+    SDL_AtomicLock(&victim->lock);
+    const int stolen = (victim->end - victim->begin + 1) / 2;
+    victim->end -= stolen;
+    const int stolen_begin = victim->end;
+    SDL_AtomicUnlock(&victim->lock);
+    if (stolen > 0) {
+      job_range_t* range = &batch->ranges[thief];
+      SDL_AtomicLock(&range->lock);
+      range->begin = stolen_begin;
+      range->end = stolen_begin + stolen;
+      SDL_AtomicUnlock(&range->lock);
+      return true;
+    }
+  }
+  return false;
+}
+
+// run jobs until every range in the batch is empty
+static void run_batch(job_batch_t* const batch, const int range_index) {
+  job_range_t* range = &batch->ranges[range_index];
+  for (;;) {
+    int index;
+    if (claim_job(range, &index)) {
+      SDL_AtomicAdd(&batch->unclaimed, -1);
+      batch->job_fn(index, batch->user_data);
+    } else if (!steal_jobs(batch, range_index)) {
+      return;
+    }
+  }
+}
+
+// first batch with jobs left to claim (mutex must be held)
+static job_batch_t* find_open_batch(void) {
+  for (job_batch_t* batch = s_batches; batch != NULL;
+       batch = batch->next_batch) {
+    if (SDL_AtomicGet(&batch->unclaimed) > 0) {
+      return batch;
+    }
+  }
+  return NULL;
+}
+
+static int run_worker(void* data) {
+  const int range_index = (int)(intptr_t)data;
+  SDL_LockMutex(s_mutex);
+  while (!s_quit) {
+    job_batch_t* batch = find_open_batch();
+    if (batch == NULL) {
+      SDL_CondWait(s_work_available, s_mutex);
+      continue;
+    }
+    batch->workers++;
+    SDL_UnlockMutex(s_mutex);
+    run_batch(batch, range_index);
+    SDL_LockMutex(s_mutex);
+    if (--batch->workers == 0) {
+      SDL_CondBroadcast(s_worker_finished);
+    }
+  }
+  SDL_UnlockMutex(s_mutex);
+  return 0;
+}
+
+void create_job_pool(const int thread_count) {
+  s_quit = false;
+  s_mutex = SDL_CreateMutex();
+  s_work_available = SDL_CreateCond();
+  s_worker_finished = SDL_CreateCond();
+  const int worker_count =
+    as_min_int(
+      thread_count > 0 ? thread_count : SDL_GetCPUCount(), JobMaxThreads)
+    - 1;
+  for (int w = 0; w < worker_count; ++w) {
+    SDL_Thread* worker =
+      SDL_CreateThread(run_worker, "job worker", (void*)(intptr_t)(w + 1));
+    if (worker == NULL) {
+      break;
+    }
+    array_push(s_workers, worker);
+  }
+}
+
+void destroy_job_pool(void) {
+  SDL_LockMutex(s_mutex);
+  s_quit = true;
+  SDL_CondBroadcast(s_work_available);
+  SDL_UnlockMutex(s_mutex);
+  for (int w = 0, worker_count = array_length(s_workers); w < worker_count;
+       ++w) {
+    SDL_WaitThread(s_workers[w], NULL);
+  }
+  array_free(s_workers);
+  s_workers = NULL;
+  SDL_DestroyCond(s_worker_finished);
+  SDL_DestroyCond(s_work_available);
+  SDL_DestroyMutex(s_mutex);
+}
+
+int job_thread_count(void) {
+  return array_length(s_workers) + 1;
+}
+
+void run_jobs(const int count, const job_fn_t job_fn, void* const user_data) {
+  if (array_length(s_workers) == 0 || count <= 1) {
+    for (int index = 0; index < count; ++index) {
+      job_fn(index, user_data);
+    }
+    return;
+  }
+
+  job_batch_t batch = {
+    .job_fn = job_fn,
+    .user_data = user_data,
+    .range_count = job_thread_count(),
+    .unclaimed = {count}};
+  // hand each thread an even share of contiguous indices to start with
+  for (int r = 0; r < batch.range_count; ++r) {
+    batch.ranges[r].begin = (int)((int64_t)count * r / batch.range_count);
+    batch.ranges[r].end = (int)((int64_t)count * (r + 1) / batch.range_count);
+  }
+
+  SDL_LockMutex(s_mutex);
+  batch.next_batch = s_batches;
+  s_batches = &batch;
+  SDL_CondBroadcast(s_work_available);
+  SDL_UnlockMutex(s_mutex);
+
+  run_batch(&batch, 0);
+
+  // every job has been claimed, wait for workers still running one
+  SDL_LockMutex(s_mutex);
+  job_batch_t** link = &s_batches;
+  while (*link != &batch) {
+    link = &(*link)->next_batch;
+  }
+  *link = batch.next_batch;
+  while (batch.workers > 0) {
+    SDL_CondWait(s_worker_finished, s_mutex);
+  }
+  SDL_UnlockMutex(s_mutex);
+}
@@ -0,0 +1,23 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// most threads a pool can run (including the calling thread)
+#define JobMaxThreads 64
+
+// job (index) runs once for every index in [0, count) of a batch
+typedef void (*job_fn_t)(int index, void* user_data);
+
+// start the worker threads (thread_count includes the calling thread, pass 0
+// to use one thread per cpu core)
+void create_job_pool(int thread_count);
+void destroy_job_pool(void);
+// number of threads running jobs (workers plus the calling thread)
+int job_thread_count(void);
+
+// run a batch of jobs across the pool and wait for them all to complete (each
+// thread starts on its own contiguous share of indices and steals from the
+// others when it runs out, the calling thread runs jobs too and batches may
+// be run from several threads at once)
+void run_jobs(int count, job_fn_t job_fn, void* user_data);
+
+#endif // JOBS_H
@@ -1,19 +1,26 @@
 #include "array.h"
+#include "assets.h"
 #include "camera.h"
 #include "display.h"
 #include "fps.h"
+#include "frames.h"
 #include "frustum.h"
-#include "lighting.h"
+#include "jobs.h"
 #include "mesh.h"
-#include "polygon.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "raster.h"
+#include "span.h"
 #include "texture.h"
 
 #include <as-ops.h>
-#include <upng.h>
 
 #include <SDL.h>
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 typedef enum display_mode_e {
   display_mode_wireframe_vertices,
@@ -21,6 +28,7 @@ typedef enum display_mode_e {
   display_mode_filled,
   display_mode_filled_wireframe,
   display_mode_textured,
+  display_mode_overdraw, // heatmap of depth test passes per pixel
   display_mode_textured_wireframe
 } display_mode_e;
 
@@ -33,68 +41,155 @@ typedef enum movement_e {
   movement_backward = 1 << 5
 } movement_e;
 
-typedef struct projected_model_t {
-  projected_triangle_t* projected_triangles;
-  int projected_count;
-} projected_model_t;
+typedef struct options_t {
+  const char* output_directory;
+  int* dump_frames; // array
+  int width;
+  int height;
+  int frame_count;
+  int thread_count; // 0 for one thread per cpu core
+  bool headless;
+  span_kernels_t span_kernels; // name is NULL to use cpu feature detection
+  texture_filter_e texture_filter;
+  bool front_to_back;
+  int pipeline_depth; // frames in flight (1 or 2)
+  const char* profile_path; // NULL unless profiling from the start
+  bool stats; // print the average stats per frame
+} options_t;
+
+// work done drawing a frame
+typedef struct frame_stats_t {
+  geometry_stats_t geometry;
+  raster_stats_t raster;
+} frame_stats_t;
 
 camera_t g_camera = {0};
 uint64_t g_previous_frame_time = 0;
 Fps g_fps = {.head_ = 0, .tail_ = FpsMaxSamples - 1};
 display_mode_e g_display_mode = display_mode_textured;
-bool g_backface_culling = true;
-as_mat44f g_perspective_projection;
-frustum_planes_t g_frustum_planes;
-const as_vec3f g_light_direction = {.z = -0.5f, .y = -0.5f};
+texture_filter_e g_texture_filter = texture_filter_nearest;
+pipeline_t g_pipeline = {
+  .light_direction = {.z = -0.5f, .y = -0.5f}, .backface_culling = true};
 as_point2i g_mouse_position = {0};
 bool g_mouse_down = false;
 int8_t g_movement = 0;
 model_t* g_models = NULL;
-projected_model_t* g_projected_models = NULL;
-int g_projected_model_count = 0;
+const frame_t* g_frame = NULL; // geometry being drawn
+raster_batch_t* g_raster_batches = NULL;
+const char* g_profile_path = "trace.json"; // written when profiling stops
+bool g_print_stats = false; // print the stats of the next frame drawn
+bool g_sum_stats = false; // add the stats of every frame drawn to g_stats
+frame_stats_t g_stats = {0};
+
+// start recording a trace or stop and write it out
+static void toggle_profiling(void) {
+  if (!is_profiling()) {
+    set_profiling(true);
+    return;
+  }
+  set_profiling(false);
+  if (write_profile_trace(g_profile_path)) {
+    fprintf(stdout, "profile trace written to %s\n", g_profile_path);
+  }
+}
+
+static void add_frame_stats(
+  frame_stats_t* const total, const frame_stats_t* const stats) {
+  total->geometry.faces_in += stats->geometry.faces_in;
+  total->geometry.backface_culled += stats->geometry.backface_culled;
+  total->geometry.frustum_rejected += stats->geometry.frustum_rejected;
+  total->geometry.clipped += stats->geometry.clipped;
+  total->geometry.triangles_emitted += stats->geometry.triangles_emitted;
+  total->raster.pixels_tested += stats->raster.pixels_tested;
+  total->raster.depth_passed += stats->raster.depth_passed;
+  total->raster.shaded += stats->raster.shaded;
+}
+
+// print stats averaged over a number of frames
+static void print_frame_stats(
+  const frame_stats_t* const stats, const int frame_count) {
+  const double frames = (double)as_max_int(frame_count, 1);
+  fprintf(
+    stdout,
+    "faces in %.0f, backface culled %.0f, frustum rejected %.0f, clipped "
+    "%.0f, triangles emitted %.0f\n"
+    "pixels tested %.0f, depth passed %.0f, shaded %.0f, overdraw %.2f\n",
+    stats->geometry.faces_in / frames,
+    stats->geometry.backface_culled / frames,
+    stats->geometry.frustum_rejected / frames,
+    stats->geometry.clipped / frames,
+    stats->geometry.triangles_emitted / frames,
+    stats->raster.pixels_tested / frames,
+    stats->raster.depth_passed / frames,
+    stats->raster.shaded / frames,
+    stats->raster.depth_passed / frames
+      / ((double)window_width() * (double)window_height()));
+}
+
+// add a model that stays empty until the asset loader hands it over
+static void request_scene_model(const model_request_t* const request) {
+  array_push(g_models, request->model);
+  const int request_id = request_model(request);
+  assert(request_id == array_length(g_models) - 1);
+  (void)request_id;
+}
+
+// fill in models that have finished loading since the last frame
+static void receive_loaded_models(void) {
+  int request_id;
+  model_t model;
+  while (take_loaded_model(&request_id, &model)) {
+    g_models[request_id] = model;
+  }
+}
 
 void setup(void) {
   create_color_buffer();
   create_depth_buffer();
+  create_raster_bins();
   const float aspect_ratio = (float)window_width() / (float)window_height();
   const float vertical_fov = as_radians_from_degrees(60.0f);
   const float near = 0.1f;
   const float far = 100.0f;
-  g_perspective_projection =
+  g_pipeline.perspective_projection =
     as_mat44f_perspective_projection_depth_zero_to_one_lh(
       aspect_ratio, vertical_fov, near, far);
-  g_frustum_planes =
+  g_pipeline.frustum_planes =
     build_frustum_planes(aspect_ratio, vertical_fov, near, far);
 
-  {
-    model_t model =
-      load_obj_mesh_with_png_texture("assets/efa.obj", "assets/efa.png");
-    model.translation = (as_vec3f){.x = 2.0f, .y = 0.2f, .z = -18.0f};
-    model.rotation = (as_vec3f){.y = -as_k_pi * 0.5f};
-    array_push(g_models, model);
-  }
-
-  {
-    model_t model =
-      load_obj_mesh_with_png_texture("assets/f22.obj", "assets/f22.png");
-    model.translation = (as_vec3f){.x = -2.0f, .y = 0.2f, .z = -18.0f};
-    model.rotation = (as_vec3f){.y = -as_k_pi * 0.5f};
-    array_push(g_models, model);
-  }
-
-  {
-    model_t model =
-      load_obj_mesh_with_png_texture("assets/f117.obj", "assets/f117.png");
-    model.translation = (as_vec3f){.y = 0.2f, .z = -14.0f};
-    model.rotation = (as_vec3f){.y = -as_k_pi * 0.5f};
-    array_push(g_models, model);
-  }
-
-  {
-    model_t model =
-      load_obj_mesh_with_png_texture("assets/runway.obj", "assets/runway.png");
-    array_push(g_models, model);
-  }
+  // models are drawn as they finish loading in the background
+  create_asset_loader();
+  request_scene_model(&(model_request_t){
+    .mesh_path = "assets/efa.obj",
+    .texture_path = "assets/efa.png",
+    .texture_filter = g_texture_filter,
+    .model = {
+      .scale = {1.0f, 1.0f, 1.0f},
+      .translation = {.x = 2.0f, .y = 0.2f, .z = -18.0f},
+      .rotation = {.y = -as_k_pi * 0.5f}}});
+  request_scene_model(&(model_request_t){
+    .mesh_path = "assets/f22.obj",
+    .texture_path = "assets/f22.png",
+    .texture_filter = g_texture_filter,
+    .model = {
+      .scale = {1.0f, 1.0f, 1.0f},
+      .translation = {.x = -2.0f, .y = 0.2f, .z = -18.0f},
+      .rotation = {.y = -as_k_pi * 0.5f}}});
+  request_scene_model(&(model_request_t){
+    .mesh_path = "assets/f117.obj",
+    .texture_path = "assets/f117.png",
+    .texture_filter = g_texture_filter,
+    .model = {
+      .scale = {1.0f, 1.0f, 1.0f},
+      .translation = {.y = 0.2f, .z = -14.0f},
+      .rotation = {.y = -as_k_pi * 0.5f}}});
+  request_scene_model(&(model_request_t){
+    .mesh_path = "assets/runway.obj",
+    .texture_path = "assets/runway.png",
+    // the runway spans the texture exactly once
+    .texture_address = texture_address_clamp,
+    .texture_filter = g_texture_filter,
+    .model = {.scale = {1.0f, 1.0f, 1.0f}}});
 
   g_camera.pitch = as_radians_from_degrees(20.0f);
   g_camera.yaw = as_radians_from_degrees(160.0f);
@@ -142,8 +237,16 @@ bool process_input(void) {
           g_display_mode = display_mode_textured;
         } else if (event.key.keysym.sym == SDLK_6) {
           g_display_mode = display_mode_textured_wireframe;
+        } else if (event.key.keysym.sym == SDLK_7) {
+          g_display_mode = display_mode_overdraw;
         } else if (event.key.keysym.sym == SDLK_c) {
-          g_backface_culling = !g_backface_culling;
+          g_pipeline.backface_culling = !g_pipeline.backface_culling;
+        } else if (event.key.keysym.sym == SDLK_f) {
+          g_pipeline.front_to_back = !g_pipeline.front_to_back;
+        } else if (event.key.keysym.sym == SDLK_p) {
+          toggle_profiling();
+        } else if (event.key.keysym.sym == SDLK_i) {
+          g_print_stats = true;
         } else if (event.key.keysym.sym == SDLK_w) {
           g_movement |= movement_forward;
         } else if (event.key.keysym.sym == SDLK_a) {
@@ -249,113 +352,32 @@ static void update_movement(const float delta_time) {
   }
 }
 
-void process_graphics_pipeline(model_t* model, const as_mat34f view) {
-  g_projected_model_count++;
-  if (array_length(g_projected_models) < g_projected_model_count) {
-    array_push(g_projected_models, (projected_model_t){0});
-  }
-
-  const as_mat33f scale = as_mat33f_scale_from_vec3f(model->scale);
-  const as_mat34f translation =
-    as_mat34f_translation_from_vec3f(model->translation);
-  const as_mat33f rotation_x = as_mat33f_x_axis_rotation(model->rotation.x);
-  const as_mat33f rotation_y = as_mat33f_y_axis_rotation(model->rotation.y);
-  const as_mat33f rotation_z = as_mat33f_z_axis_rotation(model->rotation.z);
-
-  const as_mat33f rotation_yx = as_mat33f_mul_mat33f(&rotation_y, &rotation_x);
-  const as_mat33f rotation = as_mat33f_mul_mat33f(&rotation_z, &rotation_yx);
-  const as_mat34f translation_rotation =
-    as_mat34f_mul_mat33f(&translation, &rotation);
-  const as_mat34f model_transform =
-    as_mat34f_mul_mat33f(&translation_rotation, &scale);
-
-  projected_model_t* projected_model =
-    &g_projected_models[g_projected_model_count - 1];
-  projected_model->projected_count = 0;
-
-  for (int face_index = 0, face_count = array_length(model->mesh.faces);
-       face_index < face_count;
-       ++face_index) {
-    const face_t mesh_face = model->mesh.faces[face_index];
-    const as_point3f face_vertices[] = {
-      model->mesh.vertices[mesh_face.vert_indices[0] - 1],
-      model->mesh.vertices[mesh_face.vert_indices[1] - 1],
-      model->mesh.vertices[mesh_face.vert_indices[2] - 1]};
-
-    // model -> view transform
-    uv_triangle_t transformed_triangle;
-    for (int v = 0; v < 3; ++v) {
-      const as_point3f world_position =
-        as_mat34f_mul_point3f(&model_transform, face_vertices[v]);
-      transformed_triangle.triangle.vertices[v] =
-        as_mat34f_mul_point3f(&view, world_position);
-      transformed_triangle.uvs[v] =
-        model->mesh.uvs[mesh_face.uv_indices[v] - 1];
-    }
-
-    // backface culling
-    const as_vec3f normal =
-      calculate_triangle_normal(transformed_triangle.triangle);
-    if (g_backface_culling) {
-      const as_vec3f camera_direction = as_point3f_sub_point3f(
-        (as_point3f){0}, transformed_triangle.triangle.vertices[0]);
-      const float view_dot = as_vec3f_dot_vec3f(normal, camera_direction);
-      if (view_dot < 0.0f) {
-        continue;
-      }
-    }
+// deterministic fly-by used when running headless (only depends on the frame
+// number so every run and machine renders the exact same images)
+static void update_camera_path(const int frame) {
+  const float t = (float)frame * seconds_per_frame();
+  g_camera.pitch = as_radians_from_degrees(20.0f - 10.0f * sinf(t * 0.5f));
+  g_camera.yaw = as_radians_from_degrees(160.0f + 30.0f * sinf(t * 0.25f));
+  g_camera.pivot = (as_point3f){
+    .x = -2.0f + 2.0f * sinf(t * 0.25f), .y = 2.5f, .z = -10.0f - t * 0.5f};
+}
 
-    // clipping
-    polygon_t polygon = build_polygon_from_uv_triangle(transformed_triangle);
-    clip_polygon_against_frustum(&polygon, g_frustum_planes);
-
-    // triangulate polygon
-    uv_triangle_t* clipped_triangles = uv_triangles_from_polygon(polygon);
-
-    const int triangle_count = array_length(clipped_triangles);
-    for (int t = 0; t < triangle_count; ++t) {
-      projected_model->projected_count++;
-      projected_triangle_t projected_triangle = {
-        .color = apply_light_intensity(
-          0xffffff,
-          -as_vec3f_dot_vec3f(
-            normal, as_mat34f_mul_vec3f(&view, g_light_direction))),
-        .vertices = {
-          {.uv = clipped_triangles[t].uvs[0]},
-          {.uv = clipped_triangles[t].uvs[1]},
-          {.uv = clipped_triangles[t].uvs[2]}}};
-
-      for (int v = 0; v < 3; ++v) {
-        // projection and perspective divide
-        const as_point4f projected_point = as_mat44f_project_point3f(
-          &g_perspective_projection, clipped_triangles[t].triangle.vertices[v]);
-
-        const as_mat22f window_scale = as_mat22f_scale_from_floats(
-          (float)window_width() / 2.0f, (float)window_height() / -2.0f);
-        const as_point2f projected_point_2d = as_mat22f_mul_point2f(
-          &window_scale, as_point2f_from_point4f(projected_point));
-
-        // convert to screen space
-        projected_triangle.vertices[v].point = as_point2i_add_vec2i(
-          as_point2i_from_point2f(projected_point_2d),
-          (as_vec2i){window_width() / 2, window_height() / 2});
-        projected_triangle.vertices[v].z = projected_point.z;
-        projected_triangle.vertices[v].w = projected_point.w;
-      }
+// (models may only change while no geometry is being processed)
+static void start_scene_geometry(void) {
+  receive_loaded_models();
+  start_frame_geometry(
+    &g_pipeline, g_models, array_length(g_models), camera_view(&g_camera));
+}
 
-      if (
-        array_length(projected_model->projected_triangles)
-        < projected_model->projected_count) {
-        array_push(projected_model->projected_triangles, projected_triangle);
-      } else {
-        projected_model
-          ->projected_triangles[projected_model->projected_count - 1] =
-          projected_triangle;
-      }
-    }
-    array_free(polygon.uvs);
-    array_free(polygon.vertices);
-    array_free(clipped_triangles);
+// when the frame pipeline is two frames deep, geometry started here is drawn
+// next frame and is processed while the current frame is rasterized
+static void update_graphics_pipeline(void) {
+  if (!frame_geometry_started()) {
+    start_scene_geometry();
+  }
+  g_frame = finish_frame_geometry();
+  if (frame_pipeline_depth() > 1) {
+    start_scene_geometry();
   }
 }
 
@@ -369,23 +391,35 @@ void update(void) {
 
   calculate_framerate();
 
+  profile_begin("update_movement");
   update_movement(delta_time);
+  profile_end();
+  update_graphics_pipeline();
+}
 
-  const as_mat34f view = camera_view(&g_camera);
-  g_projected_model_count = 0;
-  const int model_count = array_length(g_models);
-  for (int m = 0; m < model_count; m++) {
-    process_graphics_pipeline(&g_models[m], view);
+// filled and textured triangles are drawn in parallel one screen bin at a time
+static void rasterize_projected_models(void) {
+  array_clear(g_raster_batches);
+  for (int o = 0; o < g_frame->model_count; o++) {
+    const int m = g_frame->model_order[o];
+    const projected_model_t* projected_model = &g_frame->projected_models[m];
+    array_push(
+      g_raster_batches,
+      ((raster_batch_t){
+        .triangles = projected_model->projected_triangles,
+        .triangle_count = projected_model->projected_count,
+        .texture = g_display_mode == display_mode_textured
+                   ? &g_models[m].texture
+                   : NULL}));
   }
+  rasterize_batches(g_raster_batches, array_length(g_raster_batches));
 }
 
-void render(void) {
-  clear_color_buffer(0xff000000);
-  clear_depth_buffer();
-
-  for (int m = 0; m < g_projected_model_count; m++) {
+// wireframe modes draw lines over each triangle in turn so stay serial
+static void draw_projected_models(void) {
+  for (int m = 0; m < g_frame->model_count; m++) {
     const model_t* model = &g_models[m];
-    const projected_model_t* projected_model = &g_projected_models[m];
+    const projected_model_t* projected_model = &g_frame->projected_models[m];
     for (int i = 0, triangle_count = projected_model->projected_count;
          i < triangle_count;
          ++i) {
@@ -421,56 +455,272 @@ void render(void) {
           break;
         case display_mode_textured:
           draw_textured_triangle(
-            projected_model->projected_triangles[i], model->texture);
+            projected_model->projected_triangles[i], &model->texture);
           break;
         case display_mode_textured_wireframe:
           draw_textured_triangle(
-            projected_model->projected_triangles[i], model->texture);
+            projected_model->projected_triangles[i], &model->texture);
           draw_wire_triangle(
             projected_model->projected_triangles[i], 0xffffffff);
           break;
+        case display_mode_overdraw:
+          // always rasterized in bins (see render)
+          break;
       }
     }
   }
+}
 
+void render(void) {
+  profile_begin("render");
+  // pixels are only counted when something will use the counts
+  set_raster_stats(
+    g_print_stats || g_sum_stats || g_display_mode == display_mode_overdraw);
+  lock_color_buffer();
+  clear_color_buffer(0xff000000);
+  clear_depth_buffer();
+
+  if (
+    g_display_mode == display_mode_filled
+    || g_display_mode == display_mode_textured
+    || g_display_mode == display_mode_overdraw) {
+    rasterize_projected_models();
+  } else {
+    draw_projected_models();
+  }
+  if (g_display_mode == display_mode_overdraw) {
+    draw_overdraw_heatmap();
+  }
+
+  if (g_print_stats || g_sum_stats) {
+    const frame_stats_t stats = {
+      .geometry = g_frame->geometry_stats, .raster = raster_stats()};
+    if (g_print_stats) {
+      print_frame_stats(&stats, 1);
+      g_print_stats = false;
+    }
+    if (g_sum_stats) {
+      add_frame_stats(&g_stats, &stats);
+    }
+  }
+
+  profile_begin("present");
   render_color_buffer();
   renderer_present();
+  profile_end();
+  profile_end();
 }
 
 void teardown(void) {
-  const int projected_model_count = array_length(g_projected_models);
-  for (int m = 0; m < projected_model_count; m++) {
-    projected_model_t* projected_model = &g_projected_models[m];
-    array_free(projected_model->projected_triangles);
-  }
-  array_free(g_projected_models);
+  destroy_frame_pipeline();
+  array_free(g_raster_batches);
+  destroy_graphics_pipeline();
   const int model_count = array_length(g_models);
   for (int m = 0; m < model_count; ++m) {
-    model_t* model = &g_models[m];
-    upng_free(model->texture.png_texture);
-    array_free(model->mesh.faces);
-    array_free(model->mesh.vertices);
-    array_free(model->mesh.uvs);
+    release_model(&g_models[m]);
   }
   array_free(g_models);
+  destroy_asset_loader();
+  destroy_raster_bins();
+  destroy_job_pool();
   destroy_depth_buffer();
   destroy_color_buffer();
   deinitialize_window();
 }
 
+static void print_usage(const char* program) {
+  fprintf(
+    stderr,
+    "usage: %s [--headless] [--size <width>x<height>] [--frames <count>]\n"
+    "          [--dump <frame>]... [--output <directory>]\n"
+    "          [--span-kernels <scalar|sse2|avx2|neon>] [--threads <count>]\n"
+    "          [--texture-filter <nearest|bilinear>] [--front-to-back]\n"
+    "          [--pipeline-depth <1|2>] [--profile <trace.json>] [--stats]\n",
+    program);
+}
+
+static bool parse_options(
+  const int argc, char** argv, options_t* const options) {
+  *options = (options_t){
+    .output_directory = ".",
+    .width = 1920,
+    .height = 1080,
+    .frame_count = 600,
+    .pipeline_depth = FrameMaxPipelineDepth};
+  for (int a = 1; a < argc; ++a) {
+    const bool has_value = a + 1 < argc;
+    if (strcmp(argv[a], "--headless") == 0) {
+      options->headless = true;
+    } else if (strcmp(argv[a], "--size") == 0 && has_value) {
+      if (
+        sscanf(argv[++a], "%dx%d", &options->width, &options->height) != 2
+        || options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (strcmp(argv[a], "--frames") == 0 && has_value) {
+      options->frame_count = atoi(argv[++a]);
+    } else if (strcmp(argv[a], "--dump") == 0 && has_value) {
+      array_push(options->dump_frames, atoi(argv[++a]));
+    } else if (strcmp(argv[a], "--output") == 0 && has_value) {
+      options->output_directory = argv[++a];
+    } else if (strcmp(argv[a], "--threads") == 0 && has_value) {
+      options->thread_count = atoi(argv[++a]);
+    } else if (strcmp(argv[a], "--span-kernels") == 0 && has_value) {
+      const char* name = argv[++a];
+      if (!find_span_kernels(name, &options->span_kernels)) {
+        fprintf(stderr, "span kernels '%s' are not supported\n", name);
+        return false;
+      }
+    } else if (strcmp(argv[a], "--pipeline-depth") == 0 && has_value) {
+      options->pipeline_depth = atoi(argv[++a]);
+      if (
+        options->pipeline_depth < 1
+        || options->pipeline_depth > FrameMaxPipelineDepth) {
+        return false;
+      }
+    } else if (strcmp(argv[a], "--profile") == 0 && has_value) {
+      options->profile_path = argv[++a];
+    } else if (strcmp(argv[a], "--stats") == 0) {
+      options->stats = true;
+    } else if (strcmp(argv[a], "--front-to-back") == 0) {
+      options->front_to_back = true;
+    } else if (strcmp(argv[a], "--texture-filter") == 0 && has_value) {
+      const char* name = argv[++a];
+      if (strcmp(name, "nearest") == 0) {
+        options->texture_filter = texture_filter_nearest;
+      } else if (strcmp(name, "bilinear") == 0) {
+        options->texture_filter = texture_filter_bilinear;
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool should_dump_frame(const options_t* const options, const int frame) {
+  for (int d = 0, dump_count = array_length(options->dump_frames);
+       d < dump_count;
+       ++d) {
+    if (options->dump_frames[d] == frame) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// render a fixed number of frames as fast as possible (no frame cap or input),
+// false if any frame couldn't be dumped
+static bool run_headless(const options_t* const options) {
+  // every run draws the whole scene from the first frame
+  wait_for_requested_models();
+  const uint64_t begin_counter = SDL_GetPerformanceCounter();
+  bool dumped = true;
+  for (int frame = 0; frame < options->frame_count; ++frame) {
+    // each frame is drawn from its own point on the path however many frames
+    // are in flight
+    if (!frame_geometry_started()) {
+      update_camera_path(frame);
+      start_scene_geometry();
+    }
+    g_frame = finish_frame_geometry();
+    if (frame_pipeline_depth() > 1 && frame + 1 < options->frame_count) {
+      update_camera_path(frame + 1);
+      start_scene_geometry();
+    }
+    render();
+    if (should_dump_frame(options, frame)) {
+      char path[512];
+      snprintf(
+        path,
+        sizeof path,
+        "%s/frame-%04d.ppm",
+        options->output_directory,
+        frame);
+      dumped &= write_color_buffer_ppm(path);
+    }
+  }
+  const double seconds =
+    seconds_elapsed(begin_counter, SDL_GetPerformanceCounter());
+  fprintf(
+    stdout,
+    "%d frames at %dx%d in %.3fs (%.3fms/frame, %.1f fps, %s spans, %d "
+    "threads)\n",
+    options->frame_count,
+    window_width(),
+    window_height(),
+    seconds,
+    options->frame_count > 0 ? seconds * 1000.0 / options->frame_count : 0.0,
+    seconds > 0.0 ? options->frame_count / seconds : 0.0,
+    span_kernels_name(),
+    job_thread_count());
+  if (options->stats) {
+    print_frame_stats(&g_stats, options->frame_count);
+    const pipeline_arena_usage_t arena_usage = pipeline_arena_usage();
+    fprintf(
+      stdout,
+      "geometry arena high-water marks: frame %zu bytes (%d reserved), face "
+      "chunk %zu bytes (%d reserved)\n",
+      arena_usage.frame_high_water_mark,
+      PipelineArenaSize,
+      arena_usage.chunk_high_water_mark,
+      PipelineChunkArenaSize);
+  }
+  return dumped;
+}
+
 int main(int argc, char** argv) {
-  bool is_running = initialize_window();
+  options_t options;
+  if (!parse_options(argc, argv, &options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  bool is_running = options.headless
+                    ? initialize_headless(options.width, options.height)
+                    : initialize_window();
+  // exit with an error if the window or a headless dump failed
+  bool succeeded = is_running;
+
+  if (options.span_kernels.name != NULL) {
+    set_span_kernels(options.span_kernels);
+  }
 
+  g_texture_filter = options.texture_filter;
+  g_pipeline.front_to_back = options.front_to_back;
+  g_sum_stats = options.headless && options.stats;
+  create_profiler();
+  if (options.profile_path != NULL) {
+    g_profile_path = options.profile_path;
+    set_profiling(true);
+  }
+  create_job_pool(options.thread_count);
+  create_frame_pipeline(options.pipeline_depth);
   setup();
 
-  g_previous_frame_time = SDL_GetPerformanceCounter();
-  while (is_running) {
-    is_running = process_input();
-    update();
-    render();
+  if (options.headless) {
+    if (is_running) {
+      succeeded = run_headless(&options);
+    }
+  } else {
+    g_previous_frame_time = SDL_GetPerformanceCounter();
+    while (is_running) {
+      profile_begin("process_input");
+      is_running = process_input();
+      profile_end();
+      update();
+      render();
+    }
   }
 
   teardown();
+  if (is_profiling()) {
+    toggle_profiling();
+  }
+  destroy_profiler();
+  array_free(options.dump_frames);
 
-  return 0;
+  return succeeded ? 0 : 1;
 }
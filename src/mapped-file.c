@@ -0,0 +1,95 @@
+#include "mapped-file.h"
+
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool map_file(const char* const path, mapped_file_t* const mapped_file) {
+  *mapped_file = (mapped_file_t){0};
+  HANDLE file = CreateFileA(
+    path,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    NULL,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return true;
+  }
+  // the mapping keeps the file open
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return false;
+  }
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == NULL) {
+    CloseHandle(mapping);
+    return false;
+  }
+  *mapped_file = (mapped_file_t){
+    .data = data, .size = (size_t)size.QuadPart, .mapping = mapping};
+  return true;
+}
+
+void unmap_file(mapped_file_t* const mapped_file) {
+  if (mapped_file->data != NULL) {
+    UnmapViewOfFile(mapped_file->data);
+    CloseHandle(mapped_file->mapping);
+  }
+  *mapped_file = (mapped_file_t){0};
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_file(const char* const path, mapped_file_t* const mapped_file) {
+  *mapped_file = (mapped_file_t){0};
+  const int file = open(path, O_RDONLY);
+  if (file == -1) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(file, &file_stat) != 0) {
+    close(file);
+    return false;
+  }
+  if (file_stat.st_size == 0) {
+    close(file);
+    return true;
+  }
+  // the mapping stays valid after the file is closed
+  void* data =
+    mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  *mapped_file =
+    (mapped_file_t){.data = data, .size = (size_t)file_stat.st_size};
+  return true;
+}
+
+void unmap_file(mapped_file_t* const mapped_file) {
+  if (mapped_file->data != NULL) {
+    munmap((void*)mapped_file->data, mapped_file->size);
+  }
+  *mapped_file = (mapped_file_t){0};
+}
+
+#endif
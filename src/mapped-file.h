@@ -0,0 +1,17 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// read only view of a whole file mapped into memory
+typedef struct mapped_file_t {
+  const char* data; // NULL for empty files
+  size_t size;
+  void* mapping; // platform handle (unused on posix)
+} mapped_file_t;
+
+bool map_file(const char* path, mapped_file_t* mapped_file);
+void unmap_file(mapped_file_t* mapped_file);
+
+#endif // MAPPED_FILE_H
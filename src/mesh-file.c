@@ -0,0 +1,151 @@
+#include "mesh-file.h"
+
+#include "mesh.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define process_id _getpid
+#else
+#include <unistd.h>
+#define process_id getpid
+#endif
+
+#define MeshFileMagic 0x4853454du // "MESH"
+// bump whenever the layout of the header or any section changes
+#define MeshFileVersion 1u
+#define MeshFileAlignment 64
+
+typedef struct mesh_file_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertex_count;
+  uint32_t uv_count;
+  uint32_t face_count;
+  uint32_t reserved;
+  // byte offsets from the start of the file (multiples of MeshFileAlignment)
+  uint64_t vertices_offset;
+  uint64_t uvs_offset;
+  uint64_t faces_offset;
+  bounds_t bounds;
+} mesh_file_header_t;
+
+static uint64_t align_offset(const uint64_t offset) {
+  return (offset + MeshFileAlignment - 1) & ~(uint64_t)(MeshFileAlignment - 1);
+}
+
+static bool write_section(
+  FILE* file, const uint64_t offset, const void* data, const size_t size) {
+  static const char padding[MeshFileAlignment] = {0};
+  const long position = ftell(file);
+  return position >= 0 && (uint64_t)position <= offset
+      && fwrite(padding, 1, (size_t)(offset - position), file)
+           == offset - position
+      && fwrite(data, 1, size, file) == size;
+}
+
+bool write_mesh_file(const mesh_t* const mesh, const char* const path) {
+  mesh_file_header_t header = {
+    .magic = MeshFileMagic,
+    .version = MeshFileVersion,
+    .vertex_count = (uint32_t)mesh->vertex_count,
+    .uv_count = (uint32_t)mesh->uv_count,
+    .face_count = (uint32_t)mesh->face_count,
+    .bounds = mesh->bounds};
+  header.vertices_offset = align_offset(sizeof header);
+  header.uvs_offset = align_offset(
+    header.vertices_offset + sizeof(as_point3f) * header.vertex_count);
+  header.faces_offset =
+    align_offset(header.uvs_offset + sizeof(tex2f_t) * header.uv_count);
+
+  // write to a temporary file first so a reader never sees half a mesh (named
+  // for the process so processes building the same cache don't collide)
+  char temporary_path[1024];
+  if (
+    snprintf(
+      temporary_path,
+      sizeof temporary_path,
+      "%s.%d.tmp",
+      path,
+      (int)process_id())
+    >= (int)sizeof temporary_path) {
+    return false;
+  }
+  FILE* file = fopen(temporary_path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  const bool written =
+    fwrite(&header, sizeof header, 1, file) == 1
+    && write_section(
+      file,
+      header.vertices_offset,
+      mesh->vertices,
+      sizeof(as_point3f) * header.vertex_count)
+    && write_section(
+      file, header.uvs_offset, mesh->uvs, sizeof(tex2f_t) * header.uv_count)
+    && write_section(
+      file,
+      header.faces_offset,
+      mesh->faces,
+      sizeof(face_t) * header.face_count);
+  if (fclose(file) != 0 || !written) {
+    remove(temporary_path);
+    return false;
+  }
+  // rename does not replace existing files everywhere
+  remove(path);
+  if (rename(temporary_path, path) != 0) {
+    remove(temporary_path);
+    return false;
+  }
+  return true;
+}
+
+static bool section_fits(
+  const mapped_file_t* file,
+  const uint64_t offset,
+  const uint32_t count,
+  const size_t item_size) {
+  return offset % MeshFileAlignment == 0 && offset <= file->size
+      && (uint64_t)count * item_size <= file->size - offset;
+}
+
+bool load_mesh_file(const char* const path, mesh_t* const mesh) {
+  mapped_file_t file;
+  if (!map_file(path, &file)) {
+    return false;
+  }
+
+  const mesh_file_header_t* header = (const mesh_file_header_t*)file.data;
+  if (
+    file.size < sizeof *header || header->magic != MeshFileMagic
+    || header->version != MeshFileVersion
+    || !section_fits(
+      &file, header->vertices_offset, header->vertex_count, sizeof(as_point3f))
+    || !section_fits(
+      &file, header->uvs_offset, header->uv_count, sizeof(tex2f_t))
+    || !section_fits(
+      &file, header->faces_offset, header->face_count, sizeof(face_t))) {
+    unmap_file(&file);
+    return false;
+  }
+
+  *mesh = (mesh_t){
+    .vertices = (const as_point3f*)(file.data + header->vertices_offset),
+    .uvs = (const tex2f_t*)(file.data + header->uvs_offset),
+    .faces = (const face_t*)(file.data + header->faces_offset),
+    .vertex_count = (int)header->vertex_count,
+    .uv_count = (int)header->uv_count,
+    .face_count = (int)header->face_count,
+    .bounds = header->bounds,
+    .mapped_file = file};
+  // a stale or edited cache could index past its vertices or uvs
+  if (!mesh_indices_valid(mesh)) {
+    destroy_mesh(mesh);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,17 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdbool.h>
+
+struct mesh_t;
+
+// binary mesh format (a versioned header with the bounds followed by aligned
+// vertex, uv and face sections) that is mapped straight into memory
+
+// write a mesh (atomically replacing any existing file)
+bool write_mesh_file(const struct mesh_t* mesh, const char* path);
+// map a mesh file, the mesh arrays point into the mapping (release the mesh
+// with destroy_mesh)
+bool load_mesh_file(const char* path, struct mesh_t* mesh);
+
+#endif // MESH_FILE_H
@@ -1,78 +1,470 @@
 #include "mesh.h"
 
 #include "array.h"
+#include "jobs.h"
+#include "mapped-file.h"
+#include "mesh-file.h"
 #include "texture.h"
 
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
-model_t load_obj_mesh(const char* mesh_path) {
-  model_t model = (model_t){.scale = (as_vec3f){1.0f, 1.0f, 1.0f}};
+// bytes of an obj file parsed by one job (chunks end on a line boundary)
+#define ObjChunkSize (64 * 1024)
 
-  FILE* file = fopen(mesh_path, "r");
-
-  char buffer[128];
-  buffer[0] = '\0';
-
-  const char* separator = " ";
-  while (fgets(buffer, sizeof buffer, file) != NULL) {
-    char* line = buffer;
-    if (strncmp(line, "v ", 2) == 0) {
-      line += 2;
-      char* token = strtok(line, separator);
-      as_point3f vertex = {0};
-      float* vertices[] = {[0] = &vertex.x, [1] = &vertex.y, [2] = &vertex.z};
-      int i = 0;
-      while (token != NULL) {
-        *vertices[i++] = atof(token);
-        token = strtok(NULL, separator);
-      }
-      array_push(model.mesh.vertices, vertex);
-    } else if (strncmp(line, "vt ", 3) == 0) {
-      line += 3;
-      char* token = strtok(line, separator);
-      tex2f_t uv = {0};
-      float* uvs[] = {[0] = &uv.u, [1] = &uv.v};
-      int i = 0;
-      while (token != NULL) {
-        *uvs[i++] = atof(token);
-        token = strtok(NULL, separator);
+static bounds_t calculate_bounds(
+  const as_point3f* const vertices, const int vertex_count) {
+  if (vertex_count == 0) {
+    return (bounds_t){0};
+  }
+
+  bounds_t bounds = {.min = vertices[0], .max = vertices[0]};
+  for (int v = 1; v < vertex_count; ++v) {
+    bounds.min = (as_point3f){
+      fminf(bounds.min.x, vertices[v].x),
+      fminf(bounds.min.y, vertices[v].y),
+      fminf(bounds.min.z, vertices[v].z)};
+    bounds.max = (as_point3f){
+      fmaxf(bounds.max.x, vertices[v].x),
+      fmaxf(bounds.max.y, vertices[v].y),
+      fmaxf(bounds.max.z, vertices[v].z)};
+  }
+
+  // sphere around the box center (tighter than the box's own bounding sphere)
+  bounds.center = as_point3f_mix(bounds.min, bounds.max, 0.5f);
+  for (int v = 0; v < vertex_count; ++v) {
+    bounds.radius = fmaxf(
+      bounds.radius,
+      as_vec3f_length(as_point3f_sub_point3f(vertices[v], bounds.center)));
+  }
+  return bounds;
+}
+
+// counts of the records in part of an obj file
+typedef struct obj_counts_t {
+  int vertex_count;
+  int uv_count;
+  int face_count; // triangles (n-gons are split into fans)
+  bool missing_uvs; // a face corner has no uv index
+} obj_counts_t;
+
+typedef enum obj_record_e {
+  obj_record_other,
+  obj_record_vertex,
+  obj_record_uv,
+  obj_record_face
+} obj_record_e;
+
+static const double s_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool is_space(const char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool is_digit(const char c) {
+  return c >= '0' && c <= '9';
+}
+
+static const char* skip_spaces(const char* at, const char* const end) {
+  while (at < end && is_space(*at)) {
+    ++at;
+  }
+  return at;
+}
+
+static bool parse_int(
+  const char** const at, const char* const end, int* const value) {
+  const char* c = skip_spaces(*at, end);
+  const bool negative = c < end && *c == '-';
+  if (c < end && (*c == '-' || *c == '+')) {
+    ++c;
+  }
+  if (c == end || !is_digit(*c)) {
+    return false;
+  }
+  int magnitude = 0;
+  for (; c < end && is_digit(*c); ++c) {
+    magnitude = magnitude * 10 + (*c - '0');
+  }
+  *value = negative ? -magnitude : magnitude;
+  *at = c;
+  return true;
+}
+
+// locale independent decimal parser ([-+]digits[.digits][(e|E)[-+]digits]),
+// exact (matching strtod) for up to 15 significant digits
+static float parse_float(const char** const at, const char* const end) {
+  const char* c = skip_spaces(*at, end);
+  const bool negative = c < end && *c == '-';
+  if (c < end && (*c == '-' || *c == '+')) {
+    ++c;
+  }
+
+  uint64_t mantissa = 0;
+  int significant_digits = 0;
+  int exponent = 0;
+  for (; c < end && is_digit(*c); ++c) {
+    if (significant_digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+      significant_digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (c < end && *c == '.') {
+    for (++c; c < end && is_digit(*c); ++c) {
+      if (significant_digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+        significant_digits += mantissa != 0;
+        exponent--;
       }
-      array_push(model.mesh.uvs, uv);
-    } else if (strncmp(line, "f ", 2) == 0) {
-      line += 2;
-      char* token = strtok(line, separator);
-      face_t face = {0};
-      int v = 0;
-      int uv = 0;
-      while (token != NULL) {
-        {
-          const char* slash = strchr(token, '/');
-          const int len = slash - token;
-          char temp[32];
-          memcpy(temp, token, len);
-          temp[len] = '\0';
-          face.vert_indices[v++] = atoi(temp);
-          token += len + 1;
+    }
+  }
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    const char* exponent_at = c + 1;
+    int written_exponent;
+    if (parse_int(&exponent_at, end, &written_exponent)) {
+      exponent += written_exponent;
+      c = exponent_at;
+    }
+  }
+  *at = c;
+
+  double value = (double)mantissa;
+  if (exponent < 0) {
+    value /= -exponent <= 22 ? s_powers_of_ten[-exponent]
+                             : pow(10.0, (double)-exponent);
+  } else if (exponent > 0) {
+    value *= exponent <= 22 ? s_powers_of_ten[exponent]
+                            : pow(10.0, (double)exponent);
+  }
+  return (float)(negative ? -value : value);
+}
+
+// identify the record on a line and move past its keyword
+static obj_record_e parse_obj_record(
+  const char** const at, const char* const line_end) {
+  const char* c = skip_spaces(*at, line_end);
+  const ptrdiff_t length = line_end - c;
+  if (length >= 2 && c[0] == 'v' && is_space(c[1])) {
+    *at = c + 2;
+    return obj_record_vertex;
+  }
+  if (length >= 3 && c[0] == 'v' && c[1] == 't' && is_space(c[2])) {
+    *at = c + 3;
+    return obj_record_uv;
+  }
+  if (length >= 2 && c[0] == 'f' && is_space(c[1])) {
+    *at = c + 2;
+    return obj_record_face;
+  }
+  return obj_record_other;
+}
+
+// face corner "v", "v/vt", "v//vn" or "v/vt/vn" (uv_index is 0 if missing)
+static bool parse_face_corner(
+  const char** const at,
+  const char* const end,
+  int* const vertex_index,
+  int* const uv_index) {
+  if (!parse_int(at, end, vertex_index)) {
+    return false;
+  }
+  *uv_index = 0;
+  if (*at < end && **at == '/') {
+    ++*at;
+    if (*at < end && **at != '/') {
+      parse_int(at, end, uv_index);
+    }
+    if (*at < end && **at == '/') {
+      ++*at;
+      int normal_index;
+      parse_int(at, end, &normal_index);
+    }
+  }
+  return true;
+}
+
+// obj indices are 1-based and negative indices count back from the most
+// recent element
+static int resolve_obj_index(const int index, const int count) {
+  return index < 0 ? count + index + 1 : index;
+}
+
+static const char* next_line(const char* const at, const char* const end) {
+  const char* line_end = memchr(at, '\n', end - at);
+  return line_end != NULL ? line_end : end;
+}
+
+static obj_counts_t count_obj_records(const char* at, const char* const end) {
+  obj_counts_t counts = {0};
+  while (at < end) {
+    const char* line_end = next_line(at, end);
+    switch (parse_obj_record(&at, line_end)) {
+      case obj_record_vertex:
+        counts.vertex_count++;
+        break;
+      case obj_record_uv:
+        counts.uv_count++;
+        break;
+      case obj_record_face: {
+        int corner_count = 0;
+        for (int vertex_index, uv_index;
+             parse_face_corner(&at, line_end, &vertex_index, &uv_index);
+             ++corner_count) {
+          counts.missing_uvs |= uv_index == 0;
         }
-        {
-          const char* slash = strchr(token, '/');
-          const int len = slash - token;
-          char temp[32];
-          memcpy(temp, token, len);
-          temp[len] = '\0';
-          face.uv_indices[uv++] = atoi(temp);
+        counts.face_count += corner_count > 2 ? corner_count - 2 : 0;
+      } break;
+      case obj_record_other:
+        break;
+    }
+    at = line_end < end ? line_end + 1 : end;
+  }
+  return counts;
+}
+
+// arrays being filled by the parser
+typedef struct obj_arrays_t {
+  as_point3f* vertices;
+  tex2f_t* uvs;
+  face_t* faces;
+} obj_arrays_t;
+
+// parse records into the arrays starting at the offsets given (corners with
+// no uv use default_uv_index)
+static void parse_obj_records(
+  const char* at,
+  const char* const end,
+  const obj_counts_t offsets,
+  const int default_uv_index,
+  const obj_arrays_t* const arrays) {
+  obj_counts_t counts = offsets;
+  while (at < end) {
+    const char* line_end = next_line(at, end);
+    switch (parse_obj_record(&at, line_end)) {
+      case obj_record_vertex: {
+        as_point3f vertex;
+        vertex.x = parse_float(&at, line_end);
+        vertex.y = parse_float(&at, line_end);
+        vertex.z = parse_float(&at, line_end);
+        arrays->vertices[counts.vertex_count++] = vertex;
+      } break;
+      case obj_record_uv: {
+        tex2f_t uv;
+        uv.u = parse_float(&at, line_end);
+        uv.v = parse_float(&at, line_end);
+        arrays->uvs[counts.uv_count++] = uv;
+      } break;
+      case obj_record_face: {
+        // split into a fan around the first corner
+        face_t face = {0};
+        int corner_count = 0;
+        for (int vertex_index, uv_index;
+             parse_face_corner(&at, line_end, &vertex_index, &uv_index);
+             ++corner_count) {
+          const int corner = as_min_int(corner_count, 2);
+          face.vert_indices[corner] =
+            resolve_obj_index(vertex_index, counts.vertex_count);
+          face.uv_indices[corner] =
+            uv_index != 0 ? resolve_obj_index(uv_index, counts.uv_count)
+                          : default_uv_index;
+          if (corner_count >= 2) {
+            arrays->faces[counts.face_count++] = face;
+            face.vert_indices[1] = face.vert_indices[2];
+            face.uv_indices[1] = face.uv_indices[2];
+          }
         }
-        token = strtok(NULL, separator);
-      }
-      array_push(model.mesh.faces, face);
+      } break;
+      case obj_record_other:
+        break;
     }
+    at = line_end < end ? line_end + 1 : end;
+  }
+}
+
+// records in [begin, end) of the file, offsets are the records of every
+// earlier chunk (where this chunk's records go and what relative indices in
+// it count back from)
+typedef struct obj_chunk_t {
+  const char* begin;
+  const char* end;
+  obj_counts_t counts;
+  obj_counts_t offsets;
+} obj_chunk_t;
+
+typedef struct obj_parse_t {
+  obj_chunk_t* chunks;
+  obj_arrays_t arrays;
+  int default_uv_index;
+} obj_parse_t;
+
+static void count_obj_chunk(const int index, void* const user_data) {
+  obj_chunk_t* chunk = &((obj_parse_t*)user_data)->chunks[index];
+  chunk->counts = count_obj_records(chunk->begin, chunk->end);
+}
+
+static void parse_obj_chunk(const int index, void* const user_data) {
+  const obj_parse_t* parse = user_data;
+  const obj_chunk_t* chunk = &parse->chunks[index];
+  parse_obj_records(
+    chunk->begin,
+    chunk->end,
+    chunk->offsets,
+    parse->default_uv_index,
+    &parse->arrays);
+}
+
+bool parse_obj_mesh(const char* const mesh_path, mesh_t* const mesh) {
+  mapped_file_t file;
+  if (!map_file(mesh_path, &file)) {
+    return false;
+  }
+  const char* begin = file.data;
+  const char* end = file.data + file.size;
+
+  // split the file into chunks that each start at the beginning of a line
+  obj_parse_t parse = {0};
+  for (const char* at = begin; at < end;) {
+    const char* chunk_end =
+      end - at > ObjChunkSize ? next_line(at + ObjChunkSize, end) : end;
+    chunk_end = chunk_end < end ? chunk_end + 1 : end;
+    array_push(parse.chunks, ((obj_chunk_t){.begin = at, .end = chunk_end}));
+    at = chunk_end;
+  }
+  const int chunk_count = array_length(parse.chunks);
+
+  // count every chunk in parallel and sum them to find where each chunk's
+  // records go, sizing every array exactly before parsing
+  run_jobs(chunk_count, count_obj_chunk, &parse);
+  obj_counts_t counts = {0};
+  for (int c = 0; c < chunk_count; ++c) {
+    parse.chunks[c].offsets = counts;
+    counts.vertex_count += parse.chunks[c].counts.vertex_count;
+    counts.uv_count += parse.chunks[c].counts.uv_count;
+    counts.face_count += parse.chunks[c].counts.face_count;
+    counts.missing_uvs |= parse.chunks[c].counts.missing_uvs;
+  }
+
+  // corners without a uv share an extra default uv at the end (indices are
+  // 1-based so its index is the new uv count)
+  const int uv_count = counts.uv_count + (counts.missing_uvs ? 1 : 0);
+  parse.default_uv_index = uv_count;
+  parse.arrays = (obj_arrays_t){
+    .vertices = array_hold(NULL, counts.vertex_count, sizeof(as_point3f)),
+    .uvs = array_hold(NULL, uv_count, sizeof(tex2f_t)),
+    .faces = array_hold(NULL, counts.face_count, sizeof(face_t))};
+  if (counts.missing_uvs) {
+    parse.arrays.uvs[counts.uv_count] = (tex2f_t){0};
+  }
+
+  // chunks write to disjoint ranges of the arrays so the result matches a
+  // serial parse exactly
+  run_jobs(chunk_count, parse_obj_chunk, &parse);
+  const obj_arrays_t arrays = parse.arrays;
+  array_free(parse.chunks);
+  unmap_file(&file);
+
+  *mesh = (mesh_t){
+    .vertices = arrays.vertices,
+    .uvs = arrays.uvs,
+    .faces = arrays.faces,
+    .vertex_count = counts.vertex_count,
+    .uv_count = uv_count,
+    .face_count = counts.face_count,
+    .bounds = calculate_bounds(arrays.vertices, counts.vertex_count)};
+  // indices of 0, past the end or counting back before the first element
+  if (!mesh_indices_valid(mesh)) {
+    fprintf(stderr, "Error %s has faces with invalid indices.\n", mesh_path);
+    destroy_mesh(mesh);
+    return false;
+  }
+  return true;
+}
+
+// path.obj -> path.mesh (or path.mesh appended for other extensions)
+static bool mesh_file_path(
+  const char* const mesh_path, char* const path, const size_t size) {
+  const size_t length = strlen(mesh_path);
+  const size_t stem_length =
+    length >= 4 && strcmp(mesh_path + length - 4, ".obj") == 0 ? length - 4
+                                                               : length;
+  return snprintf(path, size, "%.*s.mesh", (int)stem_length, mesh_path)
+       < (int)size;
+}
+
+// true if the file at path exists and was modified after source (mtimes are
+// often in whole seconds, so a source saved in the same second as the file was
+// written may be newer)
+static bool is_up_to_date(const char* const path, const char* const source) {
+  struct stat file_stat;
+  struct stat source_stat;
+  return stat(path, &file_stat) == 0 && stat(source, &source_stat) == 0
+      && file_stat.st_mtime > source_stat.st_mtime;
+}
+
+model_t load_obj_mesh(const char* mesh_path) {
+  model_t model = (model_t){.scale = (as_vec3f){1.0f, 1.0f, 1.0f}};
+
+  char cache_path[1024];
+  const bool has_cache_path =
+    mesh_file_path(mesh_path, cache_path, sizeof cache_path);
+  if (
+    has_cache_path && is_up_to_date(cache_path, mesh_path)
+    && load_mesh_file(cache_path, &model.mesh)) {
+    return model;
+  }
+
+  mesh_t mesh;
+  if (!parse_obj_mesh(mesh_path, &mesh)) {
+    fprintf(stderr, "Error loading mesh %s.\n", mesh_path);
+    return model;
+  }
+
+  // switch to the mapped cache when it can be written so every load shares
+  // the same memory layout, otherwise keep the parsed arrays
+  if (
+    has_cache_path && write_mesh_file(&mesh, cache_path)
+    && load_mesh_file(cache_path, &model.mesh)) {
+    destroy_mesh(&mesh);
+  } else {
+    model.mesh = mesh;
   }
-  fclose(file);
   return model;
 }
 
+void destroy_mesh(mesh_t* const mesh) {
+  if (mesh->mapped_file.data != NULL) {
+    unmap_file(&mesh->mapped_file);
+  } else {
+    array_free((void*)mesh->vertices);
+    array_free((void*)mesh->uvs);
+    array_free((void*)mesh->faces);
+  }
+  *mesh = (mesh_t){0};
+}
+
+bool mesh_indices_valid(const mesh_t* const mesh) {
+  for (int f = 0; f < mesh->face_count; ++f) {
+    for (int v = 0; v < 3; ++v) {
+      const face_t face = mesh->faces[f];
+      if (
+        face.vert_indices[v] < 1 || face.vert_indices[v] > mesh->vertex_count
+        || face.uv_indices[v] < 1 || face.uv_indices[v] > mesh->uv_count) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 model_t load_obj_mesh_with_png_texture(
   const char* mesh_path, const char* texture_path) {
   model_t model = load_obj_mesh(mesh_path);
@@ -1,15 +1,32 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "mapped-file.h"
 #include "texture.h"
 #include "triangle.h"
 
 #include <as-ops.h>
 
+#include <stdbool.h>
+
+// model space bounding box and sphere of the mesh vertices
+typedef struct bounds_t {
+  as_point3f min;
+  as_point3f max;
+  as_point3f center;
+  float radius;
+} bounds_t;
+
 typedef struct mesh_t {
-  as_point3f* vertices;
-  tex2f_t* uvs;
-  face_t* faces;
+  const as_point3f* vertices;
+  const tex2f_t* uvs;
+  const face_t* faces;
+  int vertex_count;
+  int uv_count;
+  int face_count;
+  bounds_t bounds;
+  // binary mesh the arrays point into (data is NULL if they are allocated)
+  mapped_file_t mapped_file;
 } mesh_t;
 
 typedef struct model_t {
@@ -20,8 +37,17 @@ typedef struct model_t {
   as_vec3f translation;
 } model_t;
 
+// load an obj through a binary cache stored next to it (<name>.mesh) which is
+// created, or refreshed when the obj is newer, automatically
 model_t load_obj_mesh(const char* mesh_path);
 model_t load_obj_mesh_with_png_texture(
   const char* mesh_path, const char* texture_path);
+// parse an obj directly, bypassing the cache (false if it could not be read
+// or has invalid indices)
+bool parse_obj_mesh(const char* mesh_path, mesh_t* mesh);
+void destroy_mesh(mesh_t* mesh);
+// true if every face indexes vertices and uvs of the mesh (1-based), meshes
+// that fail would be read out of bounds when drawn
+bool mesh_indices_valid(const mesh_t* mesh);
 
 #endif // MESH_H
@@ -0,0 +1,536 @@
+#include "pipeline.h"
+
+#include "arena.h"
+#include "array.h"
+#include "display.h"
+#include "jobs.h"
+#include "lighting.h"
+#include "polygon.h"
+#include "profile.h"
+
+#include <math.h>
+#include <string.h>
+
+// a range of faces from one model processed by a single job
+typedef struct face_chunk_t {
+  int model_index;
+  int begin_face;
+  int end_face;
+  int offset; // position of the chunk's triangles in the merged output
+  arena_t arena; // reset each frame (only the chunk's job allocates from it)
+  projected_triangle_t* projected_triangles; // array (in the chunk's arena)
+  geometry_stats_t stats;
+} face_chunk_t;
+
+// a range of vertices from one model transformed by a single job
+typedef struct vertex_chunk_t {
+  int model_index;
+  int begin_vertex;
+  int end_vertex;
+} vertex_chunk_t;
+
+// bits of the triangle depth key sorted by each radix pass
+#define PipelineRadixBits 8
+#define PipelineRadixSize (1 << PipelineRadixBits)
+#define PipelineRadixPasses (32 / PipelineRadixBits)
+
+// per model state shared by each of its chunks
+typedef struct model_instance_t {
+  as_mat34f model_view; // model -> view
+  bool clipped; // model crosses the frustum so faces must be clipped
+  // view space vertex positions (in the frame arena)
+  float* xs;
+  float* ys;
+  float* zs;
+  // triangle depth keys and indices ping-ponged between radix passes (in the
+  // frame arena)
+  uint32_t* sort_keys[2];
+  int* sort_indices[2];
+  // the triangles in sorted order (array, swapped with the projected
+  // model's so kept between frames)
+  projected_triangle_t* sorted_triangles;
+} model_instance_t;
+
+typedef struct geometry_jobs_t {
+  const pipeline_t* pipeline;
+  const model_t* models;
+  as_mat34f view;
+  projected_model_t* projected_models;
+} geometry_jobs_t;
+
+static vertex_chunk_t* s_vertex_chunks = NULL; // array
+static face_chunk_t* s_face_chunks = NULL; // array
+static int s_face_chunk_count = 0;
+static model_instance_t* s_model_instances = NULL; // array (reused)
+// scratch memory for a frame's geometry (allocated from before and between
+// jobs, never by them)
+static arena_t s_arena = {0};
+
+static as_mat34f model_transform(const model_t* const model) {
+  const as_mat33f scale = as_mat33f_scale_from_vec3f(model->scale);
+  const as_mat34f translation =
+    as_mat34f_translation_from_vec3f(model->translation);
+  const as_mat33f rotation_x = as_mat33f_x_axis_rotation(model->rotation.x);
+  const as_mat33f rotation_y = as_mat33f_y_axis_rotation(model->rotation.y);
+  const as_mat33f rotation_z = as_mat33f_z_axis_rotation(model->rotation.z);
+
+  const as_mat33f rotation_yx = as_mat33f_mul_mat33f(&rotation_y, &rotation_x);
+  const as_mat33f rotation = as_mat33f_mul_mat33f(&rotation_z, &rotation_yx);
+  const as_mat34f translation_rotation =
+    as_mat34f_mul_mat33f(&translation, &rotation);
+  return as_mat34f_mul_mat33f(&translation_rotation, &scale);
+}
+
+// grow the array to at least length items
+static void* hold_items(void* array, const int length, const int item_size) {
+  const int held = array_length(array);
+  return held < length ? array_hold(array, length - held, item_size) : array;
+}
+
+static frustum_containment_e model_containment(
+  const pipeline_t* const pipeline,
+  const model_t* const model,
+  const as_mat34f* const model_view,
+  float* const nearest_depth) {
+  const bounds_t bounds = model->mesh.bounds;
+
+  // the sphere is a cheap first test, the box is tighter for long thin models
+  const as_point3f center = as_mat34f_mul_point3f(model_view, bounds.center);
+  const float scale = fmaxf(
+    fabsf(model->scale.x), fmaxf(fabsf(model->scale.y), fabsf(model->scale.z)));
+  *nearest_depth = center.z - bounds.radius * scale;
+  const frustum_containment_e sphere_containment = frustum_sphere_containment(
+    &pipeline->frustum_planes, center, bounds.radius * scale);
+  if (sphere_containment != frustum_containment_crossing) {
+    return sphere_containment;
+  }
+
+  int outside_planes = FrustumPlaneMask;
+  int crossed_planes = 0;
+  for (int c = 0; c < 8; ++c) {
+    const as_point3f corner = {
+      (c & 1) != 0 ? bounds.max.x : bounds.min.x,
+      (c & 2) != 0 ? bounds.max.y : bounds.min.y,
+      (c & 4) != 0 ? bounds.max.z : bounds.min.z};
+    const int outcode = frustum_outcode(
+      &pipeline->frustum_planes, as_mat34f_mul_point3f(model_view, corner));
+    outside_planes &= outcode;
+    crossed_planes |= outcode;
+  }
+  if (outside_planes != 0) {
+    return frustum_containment_outside;
+  }
+  return crossed_planes != 0 ? frustum_containment_crossing
+                             : frustum_containment_inside;
+}
+
+static void transform_vertex_chunk(
+  const int chunk_index, void* const user_data) {
+  const geometry_jobs_t* jobs = user_data;
+  const vertex_chunk_t* chunk = &s_vertex_chunks[chunk_index];
+  profile_begin_index("transform vertices", chunk->model_index);
+  const as_point3f* vertices = jobs->models[chunk->model_index].mesh.vertices;
+  const model_instance_t* model_instance =
+    &s_model_instances[chunk->model_index];
+
+  // columns of the model -> view matrix (whatever its storage order)
+  const as_mat34f* model_view = &model_instance->model_view;
+  const as_point3f origin = as_mat34f_mul_point3f(model_view, (as_point3f){0});
+  const as_vec3f x_axis =
+    as_mat34f_mul_vec3f(model_view, (as_vec3f){.x = 1.0f});
+  const as_vec3f y_axis =
+    as_mat34f_mul_vec3f(model_view, (as_vec3f){.y = 1.0f});
+  const as_vec3f z_axis =
+    as_mat34f_mul_vec3f(model_view, (as_vec3f){.z = 1.0f});
+
+  // separate x/y/z outputs keep the loop simple enough to vectorize
+  float* const restrict xs = model_instance->xs;
+  float* const restrict ys = model_instance->ys;
+  float* const restrict zs = model_instance->zs;
+  for (int v = chunk->begin_vertex; v < chunk->end_vertex; ++v) {
+    const float x = vertices[v].x;
+    const float y = vertices[v].y;
+    const float z = vertices[v].z;
+    xs[v] = origin.x + x_axis.x * x + y_axis.x * y + z_axis.x * z;
+    ys[v] = origin.y + x_axis.y * x + y_axis.y * y + z_axis.y * z;
+    zs[v] = origin.z + x_axis.z * x + y_axis.z * y + z_axis.z * z;
+  }
+  profile_end();
+}
+
+static void process_face_chunk(const int chunk_index, void* const user_data) {
+  const geometry_jobs_t* jobs = user_data;
+  const pipeline_t* pipeline = jobs->pipeline;
+  const as_mat34f view = jobs->view;
+  face_chunk_t* chunk = &s_face_chunks[chunk_index];
+  profile_begin_index("process faces", chunk->model_index);
+  const model_t* model = &jobs->models[chunk->model_index];
+  const model_instance_t* model_instance =
+    &s_model_instances[chunk->model_index];
+  const float* xs = model_instance->xs;
+  const float* ys = model_instance->ys;
+  const float* zs = model_instance->zs;
+
+  const as_vec3f light_direction =
+    as_mat34f_mul_vec3f(&view, pipeline->light_direction);
+  const as_mat22f window_scale = as_mat22f_scale_from_floats(
+    (float)window_width() / 2.0f, (float)window_height() / -2.0f);
+  const as_vec2i window_offset = {window_width() / 2, window_height() / 2};
+
+  // every face produces one triangle unless it is clipped
+  reset_arena(&chunk->arena);
+  chunk->projected_triangles = array_hold_arena(
+    NULL,
+    chunk->end_face - chunk->begin_face,
+    sizeof(projected_triangle_t),
+    &chunk->arena);
+  array_clear(chunk->projected_triangles);
+  geometry_stats_t stats = {
+    .faces_in = chunk->end_face - chunk->begin_face};
+
+  for (int face_index = chunk->begin_face; face_index < chunk->end_face;
+       ++face_index) {
+    const face_t mesh_face = model->mesh.faces[face_index];
+
+    // gather view space vertices
+    uv_triangle_t transformed_triangle;
+    for (int v = 0; v < 3; ++v) {
+      const int vertex_index = mesh_face.vert_indices[v] - 1;
+      transformed_triangle.triangle.vertices[v] = (as_point3f){
+        xs[vertex_index], ys[vertex_index], zs[vertex_index]};
+      transformed_triangle.uvs[v] =
+        model->mesh.uvs[mesh_face.uv_indices[v] - 1];
+    }
+
+    // backface culling
+    const as_vec3f normal =
+      calculate_triangle_normal(transformed_triangle.triangle);
+    if (pipeline->backface_culling) {
+      const as_vec3f camera_direction = as_point3f_sub_point3f(
+        (as_point3f){0}, transformed_triangle.triangle.vertices[0]);
+      const float view_dot = as_vec3f_dot_vec3f(normal, camera_direction);
+      if (view_dot < 0.0f) {
+        stats.backface_culled++;
+        continue;
+      }
+    }
+
+    // clipping
+    polygon_t polygon = build_polygon_from_uv_triangle(transformed_triangle);
+    if (model_instance->clipped) {
+      // trivially reject triangles outside of any one plane and only clip
+      // against the planes a triangle crosses (usually none)
+      int outcodes[3];
+      for (int v = 0; v < 3; ++v) {
+        outcodes[v] = frustum_outcode(
+          &pipeline->frustum_planes, transformed_triangle.triangle.vertices[v]);
+      }
+      if ((outcodes[0] & outcodes[1] & outcodes[2]) != 0) {
+        stats.frustum_rejected++;
+        continue;
+      }
+      const int crossed_planes = outcodes[0] | outcodes[1] | outcodes[2];
+      if (crossed_planes != 0) {
+        stats.clipped++;
+        profile_begin("clip polygon");
+        clip_polygon_against_frustum(
+          &polygon, pipeline->frustum_planes, crossed_planes);
+        profile_end();
+      }
+    }
+
+    projected_vertex_t projected_vertices[PolygonMaxVertices];
+    for (int v = 0; v < polygon.vertex_count; ++v) {
+      // projection and perspective divide
+      const as_point4f projected_point = as_mat44f_project_point3f(
+        &pipeline->perspective_projection, polygon.vertices[v]);
+      const as_point2f projected_point_2d = as_mat22f_mul_point2f(
+        &window_scale, as_point2f_from_point4f(projected_point));
+
+      // convert to screen space
+      projected_vertices[v] = (projected_vertex_t){
+        .point = as_point2i_add_vec2i(
+          as_point2i_from_point2f(projected_point_2d), window_offset),
+        .z = projected_point.z,
+        .w = projected_point.w,
+        .uv = polygon.uvs[v]};
+    }
+
+    // triangulate polygon
+    const uint32_t color = apply_light_intensity(
+      0xffffff, -as_vec3f_dot_vec3f(normal, light_direction));
+    for (int t = 0, triangle_count = polygon_triangle_count(&polygon);
+         t < triangle_count;
+         ++t) {
+      const projected_triangle_t projected_triangle = {
+        .vertices =
+          {projected_vertices[0],
+           projected_vertices[t + 1],
+           projected_vertices[t + 2]},
+        .color = color};
+      array_push_arena(
+        chunk->projected_triangles, projected_triangle, &chunk->arena);
+    }
+  }
+  stats.triangles_emitted = array_length(chunk->projected_triangles);
+  chunk->stats = stats;
+  profile_end();
+}
+
+// float bits that order the same way as the floats when compared as unsigned
+// integers (negative values have every bit flipped, positive ones the sign)
+static uint32_t depth_key(const float depth) {
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof bits);
+  return bits ^ ((bits & 0x80000000u) != 0 ? 0xffffffffu : 0x80000000u);
+}
+
+// stable least significant digit radix sort of the model's triangles by their
+// nearest vertex depth (passes where every key has the same digit are skipped)
+static void sort_model_triangles(const int model_index, void* const user_data) {
+  const geometry_jobs_t* jobs = user_data;
+  projected_model_t* projected_model = &jobs->projected_models[model_index];
+  model_instance_t* model_instance = &s_model_instances[model_index];
+  const int triangle_count = projected_model->projected_count;
+  if (triangle_count <= 1) {
+    return;
+  }
+  profile_begin_index("sort triangles", model_index);
+
+  model_instance->sorted_triangles = hold_items(
+    model_instance->sorted_triangles,
+    array_length(projected_model->projected_triangles),
+    sizeof(projected_triangle_t));
+
+  const projected_triangle_t* triangles = projected_model->projected_triangles;
+  uint32_t* keys = model_instance->sort_keys[0];
+  int* indices = model_instance->sort_indices[0];
+  uint32_t* sorted_keys = model_instance->sort_keys[1];
+  int* sorted_indices = model_instance->sort_indices[1];
+  int counts[PipelineRadixPasses][PipelineRadixSize] = {0};
+  for (int t = 0; t < triangle_count; ++t) {
+    const projected_vertex_t* vertices = triangles[t].vertices;
+    keys[t] = depth_key(
+      fminf(vertices[0].z, fminf(vertices[1].z, vertices[2].z)));
+    indices[t] = t;
+    for (int pass = 0; pass < PipelineRadixPasses; ++pass) {
+      const int shift = pass * PipelineRadixBits;
+      counts[pass][(keys[t] >> shift) & (PipelineRadixSize - 1)]++;
+    }
+  }
+
+  for (int pass = 0; pass < PipelineRadixPasses; ++pass) {
+    const int shift = pass * PipelineRadixBits;
+    if (counts[pass][(keys[0] >> shift) & (PipelineRadixSize - 1)]
+        == triangle_count) {
+      continue;
+    }
+    int offset = 0;
+    for (int digit = 0; digit < PipelineRadixSize; ++digit) {
+      const int count = counts[pass][digit];
+      counts[pass][digit] = offset;
+      offset += count;
+    }
+    for (int t = 0; t < triangle_count; ++t) {
+      const int position =
+        counts[pass][(keys[t] >> shift) & (PipelineRadixSize - 1)]++;
+      sorted_keys[position] = keys[t];
+      sorted_indices[position] = indices[t];
+    }
+    uint32_t* swapped_keys = keys;
+    keys = sorted_keys;
+    sorted_keys = swapped_keys;
+    int* swapped_indices = indices;
+    indices = sorted_indices;
+    sorted_indices = swapped_indices;
+  }
+
+  // gather the triangles in order then swap buffers with the projected model
+  projected_triangle_t* sorted_triangles = model_instance->sorted_triangles;
+  for (int t = 0; t < triangle_count; ++t) {
+    sorted_triangles[t] = triangles[indices[t]];
+  }
+  model_instance->sorted_triangles = projected_model->projected_triangles;
+  projected_model->projected_triangles = sorted_triangles;
+  profile_end();
+}
+
+static void merge_face_chunk(const int chunk_index, void* const user_data) {
+  const geometry_jobs_t* jobs = user_data;
+  const face_chunk_t* chunk = &s_face_chunks[chunk_index];
+  projected_model_t* projected_model =
+    &jobs->projected_models[chunk->model_index];
+  memcpy(
+    projected_model->projected_triangles + chunk->offset,
+    chunk->projected_triangles,
+    sizeof(projected_triangle_t) * array_length(chunk->projected_triangles));
+}
+
+void process_graphics_pipeline(
+  const pipeline_t* const pipeline,
+  const model_t* const models,
+  const int model_count,
+  const as_mat34f view,
+  projected_model_t* const projected_models,
+  geometry_stats_t* const stats) {
+  profile_begin("process_graphics_pipeline");
+  *stats = (geometry_stats_t){0};
+  if (s_arena.base == NULL) {
+    create_arena(&s_arena, PipelineArenaSize);
+  }
+  reset_arena(&s_arena);
+  while (array_length(s_model_instances) < model_count) {
+    array_push(s_model_instances, (model_instance_t){0});
+  }
+  array_clear(s_vertex_chunks);
+  s_face_chunk_count = 0;
+  for (int m = 0; m < model_count; ++m) {
+    model_instance_t* model_instance = &s_model_instances[m];
+    const as_mat34f transform = model_transform(&models[m]);
+    model_instance->model_view = as_mat34f_mul_mat34f(&view, &transform);
+    const frustum_containment_e containment = model_containment(
+      pipeline,
+      &models[m],
+      &model_instance->model_view,
+      &projected_models[m].nearest_depth);
+    model_instance->clipped = containment == frustum_containment_crossing;
+    // models fully outside of the frustum produce no triangles
+    if (containment == frustum_containment_outside) {
+      stats->faces_in += models[m].mesh.face_count;
+      stats->frustum_rejected += models[m].mesh.face_count;
+      continue;
+    }
+
+    const int vertex_count = models[m].mesh.vertex_count;
+    model_instance->xs = arena_allocate(&s_arena, sizeof(float) * vertex_count);
+    model_instance->ys = arena_allocate(&s_arena, sizeof(float) * vertex_count);
+    model_instance->zs = arena_allocate(&s_arena, sizeof(float) * vertex_count);
+    for (int begin_vertex = 0; begin_vertex < vertex_count;
+         begin_vertex += PipelineVertexChunkSize) {
+      const vertex_chunk_t chunk = {
+        .model_index = m,
+        .begin_vertex = begin_vertex,
+        .end_vertex =
+          as_min_int(begin_vertex + PipelineVertexChunkSize, vertex_count)};
+      array_push(s_vertex_chunks, chunk);
+    }
+
+    const int face_count = models[m].mesh.face_count;
+    for (int begin_face = 0; begin_face < face_count;
+         begin_face += PipelineFaceChunkSize) {
+      if (array_length(s_face_chunks) == s_face_chunk_count) {
+        array_push(s_face_chunks, (face_chunk_t){0});
+        create_arena(
+          &s_face_chunks[s_face_chunk_count].arena, PipelineChunkArenaSize);
+      }
+      face_chunk_t* chunk = &s_face_chunks[s_face_chunk_count++];
+      chunk->model_index = m;
+      chunk->begin_face = begin_face;
+      chunk->end_face =
+        as_min_int(begin_face + PipelineFaceChunkSize, face_count);
+    }
+  }
+
+  geometry_jobs_t jobs = {
+    .pipeline = pipeline,
+    .models = models,
+    .view = view,
+    .projected_models = projected_models};
+  run_jobs(array_length(s_vertex_chunks), transform_vertex_chunk, &jobs);
+  run_jobs(s_face_chunk_count, process_face_chunk, &jobs);
+
+  // chunks are laid out one after another in face order
+  for (int m = 0; m < model_count; ++m) {
+    projected_models[m].projected_count = 0;
+  }
+  for (int c = 0; c < s_face_chunk_count; ++c) {
+    face_chunk_t* chunk = &s_face_chunks[c];
+    projected_model_t* projected_model = &projected_models[chunk->model_index];
+    chunk->offset = projected_model->projected_count;
+    projected_model->projected_count +=
+      array_length(chunk->projected_triangles);
+    stats->faces_in += chunk->stats.faces_in;
+    stats->backface_culled += chunk->stats.backface_culled;
+    stats->frustum_rejected += chunk->stats.frustum_rejected;
+    stats->clipped += chunk->stats.clipped;
+    stats->triangles_emitted += chunk->stats.triangles_emitted;
+  }
+  for (int m = 0; m < model_count; ++m) {
+    projected_model_t* projected_model = &projected_models[m];
+    const int length = array_length(projected_model->projected_triangles);
+    if (length < projected_model->projected_count) {
+      projected_model->projected_triangles = array_hold(
+        projected_model->projected_triangles,
+        projected_model->projected_count - length,
+        sizeof(projected_triangle_t));
+    }
+  }
+  run_jobs(s_face_chunk_count, merge_face_chunk, &jobs);
+  if (pipeline->front_to_back) {
+    for (int m = 0; m < model_count; ++m) {
+      const int triangle_count = projected_models[m].projected_count;
+      model_instance_t* model_instance = &s_model_instances[m];
+      for (int b = 0; b < 2; ++b) {
+        model_instance->sort_keys[b] =
+          arena_allocate(&s_arena, sizeof(uint32_t) * triangle_count);
+        model_instance->sort_indices[b] =
+          arena_allocate(&s_arena, sizeof(int) * triangle_count);
+      }
+    }
+    run_jobs(model_count, sort_model_triangles, &jobs);
+  }
+  profile_end();
+}
+
+void order_projected_models(
+  const pipeline_t* const pipeline,
+  const projected_model_t* const projected_models,
+  const int model_count,
+  int* const order) {
+  // there are only ever a handful of models so an insertion sort will do
+  for (int m = 0; m < model_count; ++m) {
+    int position = m;
+    if (pipeline->front_to_back) {
+      for (; position > 0
+             && projected_models[order[position - 1]].nearest_depth
+                  > projected_models[m].nearest_depth;
+           --position) {
+        order[position] = order[position - 1];
+      }
+    }
+    order[position] = m;
+  }
+}
+
+pipeline_arena_usage_t pipeline_arena_usage(void) {
+  pipeline_arena_usage_t usage = {
+    .frame_high_water_mark = s_arena.high_water_mark};
+  for (int c = 0, chunk_count = array_length(s_face_chunks); c < chunk_count;
+       ++c) {
+    const size_t high_water_mark = s_face_chunks[c].arena.high_water_mark;
+    if (high_water_mark > usage.chunk_high_water_mark) {
+      usage.chunk_high_water_mark = high_water_mark;
+    }
+  }
+  return usage;
+}
+
+void destroy_graphics_pipeline(void) {
+  for (int c = 0, chunk_count = array_length(s_face_chunks); c < chunk_count;
+       ++c) {
+    destroy_arena(&s_face_chunks[c].arena);
+  }
+  array_free(s_face_chunks);
+  s_face_chunks = NULL;
+  array_free(s_vertex_chunks);
+  s_vertex_chunks = NULL;
+  s_face_chunk_count = 0;
+  for (int m = 0, model_count = array_length(s_model_instances);
+       m < model_count;
+       ++m) {
+    array_free(s_model_instances[m].sorted_triangles);
+  }
+  array_free(s_model_instances);
+  s_model_instances = NULL;
+  destroy_arena(&s_arena);
+}
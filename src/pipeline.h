@@ -0,0 +1,79 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "frustum.h"
+#include "mesh.h"
+#include "triangle.h"
+
+#include <as-ops.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// number of vertices transformed by each vertex job
+#define PipelineVertexChunkSize 4096
+// number of faces culled, clipped and projected by each face job
+#define PipelineFaceChunkSize 512
+// bytes reserved up front for a frame's scratch geometry (vertex positions
+// and sort buffers) and for each face chunk's triangles, arenas grow to their
+// high-water mark if these are too small
+#define PipelineArenaSize (1 << 20)
+#define PipelineChunkArenaSize (64 << 10)
+
+typedef struct projected_model_t {
+  projected_triangle_t* projected_triangles;
+  int projected_count;
+  float nearest_depth; // view space depth of the nearest point of its bounds
+} projected_model_t;
+
+// faces and triangles through each stage of the pipeline in a frame
+typedef struct geometry_stats_t {
+  int faces_in; // every face of every model
+  int backface_culled;
+  // faces outside a frustum plane (or of a model outside the frustum)
+  int frustum_rejected;
+  int clipped; // faces crossing at least one frustum plane
+  int triangles_emitted; // after clipped polygons are triangulated
+} geometry_stats_t;
+
+// most scratch memory used by the geometry stage in any frame (to size the
+// arenas up front)
+typedef struct pipeline_arena_usage_t {
+  size_t frame_high_water_mark;
+  size_t chunk_high_water_mark; // largest of any face chunk
+} pipeline_arena_usage_t;
+
+typedef struct pipeline_t {
+  as_mat44f perspective_projection;
+  frustum_planes_t frustum_planes;
+  as_vec3f light_direction;
+  bool backface_culling;
+  // sort each model's triangles nearest first so the depth test rejects
+  // more of the pixels behind them before they are shaded
+  bool front_to_back;
+} pipeline_t;
+
+// transform, cull, clip and project every face of every model (each vertex is
+// transformed to view space once, then faces are split into chunks processed
+// in parallel on the job pool and merged back in face order so the output
+// matches processing faces one at a time), stats are counted for the frame
+void process_graphics_pipeline(
+  const pipeline_t* pipeline,
+  const model_t* models,
+  int model_count,
+  as_mat34f view,
+  projected_model_t* projected_models,
+  geometry_stats_t* stats);
+// model indices from nearest to furthest (in model order unless the pipeline
+// sorts front to back)
+void order_projected_models(
+  const pipeline_t* pipeline,
+  const projected_model_t* projected_models,
+  int model_count,
+  int* order);
+// (only while no geometry is being processed)
+pipeline_arena_usage_t pipeline_arena_usage(void);
+// release the buffers kept between frames
+void destroy_graphics_pipeline(void);
+
+#endif // PIPELINE_H
@@ -7,18 +7,24 @@
 
 #include <as-ops.h>
 
+// clipping a triangle against each frustum plane adds at most one vertex
+#define PolygonMaxVertices (3 + FrustumPlaneCount)
+
 typedef struct polygon_t {
-  as_point3f* vertices; // array
-  tex2f_t* uvs; // array
+  as_point3f vertices[PolygonMaxVertices];
+  tex2f_t uvs[PolygonMaxVertices];
+  int vertex_count;
 } polygon_t;
 
 polygon_t build_polygon_from_triangle(triangle_t triangle);
 polygon_t build_polygon_from_uv_triangle(uv_triangle_t triangle);
 
+// clip against the planes with a bit set in plane_mask (1 << frustum_plane_e)
 void clip_polygon_against_frustum(
-  polygon_t* polygon, frustum_planes_t frustum_planes);
+  polygon_t* polygon, frustum_planes_t frustum_planes, int plane_mask);
 
-triangle_t* triangles_from_polygon(polygon_t polygon);
-uv_triangle_t* uv_triangles_from_polygon(polygon_t polygon);
+// polygons are triangulated as a fan around the first vertex (triangle t is
+// made from vertices 0, t + 1 and t + 2)
+int polygon_triangle_count(const polygon_t* polygon);
 
 #endif // POLYGON_H
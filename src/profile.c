@@ -0,0 +1,214 @@
+#include "profile.h"
+
+#include "array.h"
+
+#include <SDL.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct profile_zone_t {
+  const char* name;
+  int index; // -1 if untagged
+  uint64_t begin;
+  uint64_t end;
+} profile_zone_t;
+
+// a zone begun but not yet ended
+typedef struct open_zone_t {
+  const char* name;
+  int index;
+  uint64_t begin;
+  int session; // zones left open from an earlier session are dropped
+} open_zone_t;
+
+// zones recorded by one thread (only it writes them)
+typedef struct thread_zones_t {
+  SDL_SpinLock lock; // held while recording a zone or copying the ring
+  profile_zone_t* zones; // ring of ProfileMaxZones
+  int64_t zone_count; // every zone recorded (the ring keeps the most recent)
+  open_zone_t open_zones[ProfileMaxDepth];
+  int depth; // may exceed ProfileMaxDepth (deeper zones aren't recorded)
+  int session;
+  int thread_index;
+} thread_zones_t;
+
+static SDL_TLSID s_thread_zones_id = 0;
+static SDL_mutex* s_mutex = NULL; // guards the thread list
+static thread_zones_t** s_threads = NULL; // array
+static SDL_atomic_t s_enabled = {0};
+static SDL_atomic_t s_session = {0}; // incremented each time profiling starts
+static uint64_t s_origin = 0; // counter when profiling started
+
+static thread_zones_t* current_thread_zones(void) {
+  thread_zones_t* thread = SDL_TLSGet(s_thread_zones_id);
+  if (thread != NULL) {
+    return thread;
+  }
+  thread = calloc(1, sizeof *thread);
+  thread->zones = malloc(sizeof(profile_zone_t) * ProfileMaxZones);
+  SDL_LockMutex(s_mutex);
+  thread->thread_index = array_length(s_threads);
+  array_push(s_threads, thread);
+  SDL_UnlockMutex(s_mutex);
+  SDL_TLSSet(s_thread_zones_id, thread, NULL);
+  return thread;
+}
+
+void create_profiler(void) {
+  s_thread_zones_id = SDL_TLSCreate();
+  s_mutex = SDL_CreateMutex();
+}
+
+// (every other thread that recorded zones must have exited)
+void destroy_profiler(void) {
+  SDL_AtomicSet(&s_enabled, 0);
+  for (int t = 0, thread_count = array_length(s_threads); t < thread_count;
+       ++t) {
+    free(s_threads[t]->zones);
+    free(s_threads[t]);
+  }
+  array_free(s_threads);
+  s_threads = NULL;
+  SDL_TLSSet(s_thread_zones_id, NULL, NULL);
+  SDL_DestroyMutex(s_mutex);
+}
+
+void set_profiling(const bool enabled) {
+  if (enabled == is_profiling()) {
+    return;
+  }
+  if (enabled) {
+    SDL_LockMutex(s_mutex);
+    for (int t = 0, thread_count = array_length(s_threads); t < thread_count;
+         ++t) {
+      SDL_AtomicLock(&s_threads[t]->lock);
+      s_threads[t]->zone_count = 0;
+      SDL_AtomicUnlock(&s_threads[t]->lock);
+    }
+    SDL_UnlockMutex(s_mutex);
+    s_origin = SDL_GetPerformanceCounter();
+    SDL_AtomicAdd(&s_session, 1);
+  }
+  SDL_AtomicSet(&s_enabled, enabled ? 1 : 0);
+}
+
+bool is_profiling(void) {
+  return SDL_AtomicGet(&s_enabled) != 0;
+}
+
+void profile_begin(const char* const name) {
+  profile_begin_index(name, -1);
+}
+
+void profile_begin_index(const char* const name, const int index) {
+  if (SDL_AtomicGet(&s_enabled) == 0) {
+    return;
+  }
+  thread_zones_t* thread = current_thread_zones();
+  const int session = SDL_AtomicGet(&s_session);
+  if (thread->session != session) {
+    thread->session = session;
+    thread->depth = 0;
+  }
+  if (thread->depth < ProfileMaxDepth) {
+    thread->open_zones[thread->depth] = (open_zone_t){
+      .name = name,
+      .index = index,
+      .begin = SDL_GetPerformanceCounter(),
+      .session = session};
+  }
+  thread->depth++;
+}
+
+void profile_end(void) {
+  if (SDL_AtomicGet(&s_enabled) == 0) {
+    return;
+  }
+  const uint64_t end = SDL_GetPerformanceCounter();
+  thread_zones_t* thread = SDL_TLSGet(s_thread_zones_id);
+  if (thread == NULL || thread->depth == 0) {
+    return;
+  }
+  thread->depth--;
+  if (thread->depth >= ProfileMaxDepth) {
+    return;
+  }
+  const open_zone_t* open_zone = &thread->open_zones[thread->depth];
+  if (open_zone->session != SDL_AtomicGet(&s_session)) {
+    return;
+  }
+  SDL_AtomicLock(&thread->lock);
+  thread->zones[thread->zone_count % ProfileMaxZones] = (profile_zone_t){
+    .name = open_zone->name,
+    .index = open_zone->index,
+    .begin = open_zone->begin,
+    .end = end};
+  thread->zone_count++;
+  SDL_AtomicUnlock(&thread->lock);
+}
+
+static double microseconds(const uint64_t counter) {
+  return (double)(int64_t)(counter - s_origin) * 1000000.0
+       / (double)SDL_GetPerformanceFrequency();
+}
+
+bool write_profile_trace(const char* const path) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s for writing.\n", path);
+    return false;
+  }
+
+  // zones are copied out so threads still recording aren't held up by the
+  // file being written
+  profile_zone_t* zones = malloc(sizeof(profile_zone_t) * ProfileMaxZones);
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first_event = true;
+  SDL_LockMutex(s_mutex);
+  for (int t = 0, thread_count = array_length(s_threads); t < thread_count;
+       ++t) {
+    thread_zones_t* thread = s_threads[t];
+    SDL_AtomicLock(&thread->lock);
+    const int64_t zone_count = thread->zone_count;
+    const int64_t first_zone =
+      zone_count > ProfileMaxZones ? zone_count - ProfileMaxZones : 0;
+    for (int64_t z = first_zone; z < zone_count; ++z) {
+      zones[z - first_zone] = thread->zones[z % ProfileMaxZones];
+    }
+    SDL_AtomicUnlock(&thread->lock);
+
+    fprintf(
+      file,
+      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+      "\"args\":{\"name\":\"%s %d\"}}",
+      first_event ? "" : ",\n",
+      thread->thread_index,
+      thread->thread_index == 0 ? "main" : "thread",
+      thread->thread_index);
+    first_event = false;
+    for (int64_t z = 0; z < zone_count - first_zone; ++z) {
+      const profile_zone_t* zone = &zones[z];
+      fprintf(
+        file,
+        ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+        "\"dur\":%.3f",
+        zone->name,
+        thread->thread_index,
+        microseconds(zone->begin),
+        microseconds(zone->end) - microseconds(zone->begin));
+      if (zone->index >= 0) {
+        fprintf(file, ",\"args\":{\"index\":%d}", zone->index);
+      }
+      fprintf(file, "}");
+    }
+  }
+  SDL_UnlockMutex(s_mutex);
+  fprintf(file, "\n]}\n");
+  free(zones);
+
+  const bool written = ferror(file) == 0;
+  fclose(file);
+  return written;
+}
@@ -0,0 +1,29 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+// zones each thread keeps (the oldest are overwritten once full)
+#define ProfileMaxZones (1 << 16)
+// deepest zones can be nested on one thread
+#define ProfileMaxDepth 32
+
+void create_profiler(void);
+void destroy_profiler(void);
+
+// start recording zones (discarding any recorded before) or stop
+void set_profiling(bool enabled);
+bool is_profiling(void);
+
+// time from a begin to the matching end on the same thread (zones nest, the
+// name must be a string literal), only checks a flag while not profiling
+void profile_begin(const char* name);
+// a zone tagged with an index (e.g. the model it processes)
+void profile_begin_index(const char* name, int index);
+void profile_end(void);
+
+// write every recorded zone as Chrome trace event json (load it in
+// chrome://tracing or https://ui.perfetto.dev)
+bool write_profile_trace(const char* path);
+
+#endif // PROFILE_H
@@ -0,0 +1,122 @@
+#include "raster.h"
+
+#include "array.h"
+#include "display.h"
+#include "jobs.h"
+#include "profile.h"
+#include "texture.h"
+#include "triangle.h"
+
+#include <as-ops.h>
+
+#include <stdlib.h>
+
+#if RasterBinSize % TileSize != 0
+#error RasterBinSize must be a multiple of TileSize
+#endif
+
+typedef struct bin_entry_t {
+  int batch_index;
+  int triangle_index;
+  // mip level picked when the triangle was binned (NULL to fill with the
+  // triangle's color)
+  const texture_level_t* level;
+} bin_entry_t;
+
+static bin_entry_t** s_bins = NULL; // an array of entries for each bin
+static int s_bin_columns = 0;
+static int s_bin_rows = 0;
+
+void create_raster_bins(void) {
+  s_bin_columns = (window_width() + RasterBinSize - 1) / RasterBinSize;
+  s_bin_rows = (window_height() + RasterBinSize - 1) / RasterBinSize;
+  s_bins = calloc(s_bin_columns * s_bin_rows, sizeof(bin_entry_t*));
+}
+
+void destroy_raster_bins(void) {
+  for (int b = 0, bin_count = s_bin_columns * s_bin_rows; b < bin_count; ++b) {
+    array_free(s_bins[b]);
+  }
+  free(s_bins);
+  s_bins = NULL;
+}
+
+static void bin_triangle(
+  const projected_triangle_t* const triangle,
+  const texture_t* const texture,
+  bin_entry_t entry) {
+  const as_point2i p0 = triangle->vertices[0].point;
+  const as_point2i p1 = triangle->vertices[1].point;
+  const as_point2i p2 = triangle->vertices[2].point;
+  const int min_x = as_max_int(as_min_int(p0.x, as_min_int(p1.x, p2.x)), 0);
+  const int min_y = as_max_int(as_min_int(p0.y, as_min_int(p1.y, p2.y)), 0);
+  const int max_x = as_min_int(
+    as_max_int(p0.x, as_max_int(p1.x, p2.x)), window_width() - 1);
+  const int max_y = as_min_int(
+    as_max_int(p0.y, as_max_int(p1.y, p2.y)), window_height() - 1);
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+  entry.level =
+    texture != NULL ? select_texture_level(triangle, texture) : NULL;
+  for (int row = min_y / RasterBinSize; row <= max_y / RasterBinSize; ++row) {
+    for (int column = min_x / RasterBinSize; column <= max_x / RasterBinSize;
+         ++column) {
+      array_push(s_bins[row * s_bin_columns + column], entry);
+    }
+  }
+}
+
+static void rasterize_bin(const int bin, void* const user_data) {
+  const raster_batch_t* batches = user_data;
+  const bin_entry_t* entries = s_bins[bin];
+  const int entry_count = array_length(s_bins[bin]);
+  if (entry_count == 0) {
+    return;
+  }
+
+  const as_point2i origin = {
+    .x = (bin % s_bin_columns) * RasterBinSize,
+    .y = (bin / s_bin_columns) * RasterBinSize};
+  const as_rect clip = {
+    .pos = origin,
+    .size = (as_size2i){
+      .width = as_min_int(RasterBinSize, window_width() - origin.x),
+      .height = as_min_int(RasterBinSize, window_height() - origin.y)}};
+
+  profile_begin_index("rasterize bin", bin);
+  for (int e = 0; e < entry_count; ++e) {
+    const raster_batch_t* batch = &batches[entries[e].batch_index];
+    const projected_triangle_t* triangle =
+      &batch->triangles[entries[e].triangle_index];
+    if (entries[e].level != NULL) {
+      draw_textured_triangle_clipped(triangle, entries[e].level, clip);
+    } else {
+      draw_filled_triangle_clipped(triangle, triangle->color, clip);
+    }
+  }
+  profile_end();
+}
+
+void rasterize_batches(
+  const raster_batch_t* const batches, const int batch_count) {
+  const int bin_count = s_bin_columns * s_bin_rows;
+  for (int b = 0; b < bin_count; ++b) {
+    array_clear(s_bins[b]);
+  }
+
+  // entries are appended in draw order so each bin keeps the serial ordering
+  profile_begin("bin triangles");
+  for (int b = 0; b < batch_count; ++b) {
+    for (int t = 0; t < batches[b].triangle_count; ++t) {
+      bin_triangle(
+        &batches[b].triangles[t],
+        batches[b].texture,
+        (bin_entry_t){.batch_index = b, .triangle_index = t});
+    }
+  }
+  profile_end();
+
+  // bins cover separate parts of the color/depth buffers so need no locking
+  run_jobs(bin_count, rasterize_bin, (void*)batches);
+}
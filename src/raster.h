@@ -0,0 +1,26 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+// size (in pixels) of the square screen bins triangles are sorted into (a
+// multiple of TileSize so binned and serial rasterization match exactly)
+#define RasterBinSize 64
+
+struct projected_triangle_t;
+struct texture_t;
+
+// triangles drawn with the same texture (in order)
+typedef struct raster_batch_t {
+  const struct projected_triangle_t* triangles;
+  int triangle_count;
+  const struct texture_t* texture; // NULL to fill with each triangle's color
+} raster_batch_t;
+
+void create_raster_bins(void);
+void destroy_raster_bins(void);
+
+// sort triangles into the screen bins they overlap and rasterize the bins in
+// parallel on the job pool (the result is identical to drawing every batch
+// one triangle at a time)
+void rasterize_batches(const raster_batch_t* batches, int batch_count);
+
+#endif // RASTER_H
@@ -0,0 +1,205 @@
+#include "span.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+// one lane per pixel of a full span
+#if SpanMaxLength != 8
+#error AVX2 span kernels expect spans of 8 pixels
+#endif
+
+static __m256 lane_values(const float value, const float step) {
+  const __m256 lanes =
+    _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  return _mm256_add_ps(
+    _mm256_set1_ps(value), _mm256_mul_ps(_mm256_set1_ps(step), lanes));
+}
+
+static __m256i lane_weights(const int weight, const int step) {
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_add_epi32(
+    _mm256_set1_epi32(weight),
+    _mm256_mullo_epi32(_mm256_set1_epi32(step), lanes));
+}
+
+// lanes inside the span and inside all three edges
+static __m256i lane_coverage(const span_t* const span) {
+  const __m256i weights = _mm256_or_si256(
+    lane_weights(span->weights[0], span->weight_steps[0]),
+    _mm256_or_si256(
+      lane_weights(span->weights[1], span->weight_steps[1]),
+      lane_weights(span->weights[2], span->weight_steps[2])));
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  return _mm256_and_si256(
+    _mm256_cmpgt_epi32(weights, _mm256_set1_epi32(-1)),
+    _mm256_cmpgt_epi32(_mm256_set1_epi32(span->length), lanes));
+}
+
+// lanes that are covered and pass the depth test (masked loads never touch
+// memory past the end of the span)
+static __m256i lane_depth_pass(
+  const span_t* const span, const __m256i coverage, const __m256 depth) {
+  const __m256 previous_depth =
+    _mm256_maskload_ps(span->depth_buffer, coverage);
+  return _mm256_and_si256(
+    coverage,
+    _mm256_castps_si256(_mm256_cmp_ps(depth, previous_depth, _CMP_LT_OQ)));
+}
+
+// reduce wrapped lanes at least SpanWrapLimit from zero (or not finite) the
+// way the samplers in texture.c do, which is rare so done one lane at a time
+static __m256 reduce_wrapped_lanes(__m256 scaled, const int size) {
+  const int in_range = _mm256_movemask_ps(_mm256_cmp_ps(
+    _mm256_andnot_ps(_mm256_set1_ps(-0.0f), scaled),
+    _mm256_set1_ps(SpanWrapLimit),
+    _CMP_LT_OQ));
+  if (in_range == (1 << SpanMaxLength) - 1) {
+    return scaled;
+  }
+  float lanes[SpanMaxLength];
+  _mm256_storeu_ps(lanes, scaled);
+  for (int lane = 0; lane < SpanMaxLength; lane++) {
+    if ((in_range & (1 << lane)) == 0) {
+      lanes[lane] = reduce_wrapped_coordinate(lanes[lane], size);
+    }
+  }
+  return _mm256_loadu_ps(lanes);
+}
+
+// matches the nearest texel samplers in texture.c
+static __m256i texel_coordinates(
+  const __m256 t, const int size, const texture_address_e address) {
+  const __m256 size_f = _mm256_set1_ps((float)size);
+  __m256 scaled = _mm256_mul_ps(t, size_f);
+  if (address == texture_address_clamp) {
+    scaled =
+      _mm256_min_ps(_mm256_max_ps(scaled, _mm256_set1_ps(-1.0f)), size_f);
+  } else {
+    scaled = reduce_wrapped_lanes(scaled, size);
+  }
+  // floor (truncate then subtract one where that rounded up)
+  const __m256i truncated = _mm256_cvttps_epi32(scaled);
+  const __m256i texel = _mm256_add_epi32(
+    truncated,
+    _mm256_castps_si256(
+      _mm256_cmp_ps(_mm256_cvtepi32_ps(truncated), scaled, _CMP_GT_OQ)));
+
+  const __m256i last = _mm256_set1_epi32(size - 1);
+  if (address == texture_address_clamp) {
+    return _mm256_min_epi32(
+      _mm256_max_epi32(texel, _mm256_setzero_si256()), last);
+  }
+  if ((size & (size - 1)) == 0) {
+    return _mm256_and_si256(texel, last);
+  }
+  // estimate how many times the texture repeats then correct the remainder
+  // if the estimate is out by one (the reduction keeps the estimate in range)
+  const __m256i repeats = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(
+    _mm256_cvtepi32_ps(texel), _mm256_set1_ps(1.0f / (float)size))));
+  const __m256i size_i = _mm256_set1_epi32(size);
+  __m256i wrapped =
+    _mm256_sub_epi32(texel, _mm256_mullo_epi32(repeats, size_i));
+  wrapped = _mm256_add_epi32(
+    wrapped,
+    _mm256_and_si256(
+      _mm256_cmpgt_epi32(_mm256_setzero_si256(), wrapped), size_i));
+  return _mm256_sub_epi32(
+    wrapped, _mm256_and_si256(_mm256_cmpgt_epi32(wrapped, last), size_i));
+}
+
+// matches texel_index
+static __m256i texel_indices(
+  const texture_level_t* const texture, const __m256i x, const __m256i y) {
+  const __m256i mask = _mm256_set1_epi32(TextureTileMask);
+  const __m256i tile = _mm256_add_epi32(
+    _mm256_mullo_epi32(
+      _mm256_srli_epi32(y, TextureTileShift),
+      _mm256_set1_epi32(texture->tile_columns)),
+    _mm256_srli_epi32(x, TextureTileShift));
+  return _mm256_or_si256(
+    _mm256_slli_epi32(tile, TextureTileShift * 2),
+    _mm256_or_si256(
+      _mm256_slli_epi32(_mm256_and_si256(y, mask), TextureTileShift),
+      _mm256_and_si256(x, mask)));
+}
+
+static void span_fill_avx2(
+  const span_t* const span, const void* const user_data) {
+  const __m256 depth = lane_values(span->depth, span->depth_step);
+  const __m256i pass = lane_depth_pass(span, lane_coverage(span), depth);
+  if (_mm256_testz_si256(pass, pass)) {
+    return;
+  }
+  _mm256_maskstore_epi32(
+    (int*)span->color_buffer,
+    pass,
+    _mm256_set1_epi32(*(const int32_t*)user_data));
+  _mm256_maskstore_ps(span->depth_buffer, pass, depth);
+}
+
+static void span_texture_avx2(
+  const span_t* const span, const void* const user_data) {
+  const texture_level_t* texture = (const texture_level_t*)user_data;
+  const __m256 depth = lane_values(span->depth, span->depth_step);
+  const __m256i pass = lane_depth_pass(span, lane_coverage(span), depth);
+  if (_mm256_testz_si256(pass, pass)) {
+    return;
+  }
+
+  // perspective correct uv
+  const __m256 w = _mm256_div_ps(
+    _mm256_set1_ps(1.0f), lane_values(span->w_recip, span->w_recip_step));
+  const __m256 u =
+    _mm256_mul_ps(lane_values(span->uv_over_w.u, span->uv_over_w_step.u), w);
+  const __m256 v =
+    _mm256_mul_ps(lane_values(span->uv_over_w.v, span->uv_over_w_step.v), w);
+
+  __m256i texels;
+  if (texture->filter == texture_filter_nearest) {
+    const __m256i index = texel_indices(
+      texture,
+      texel_coordinates(u, texture->width, texture->address),
+      texel_coordinates(v, texture->height, texture->address));
+    texels = _mm256_mask_i32gather_epi32(
+      _mm256_setzero_si256(),
+      (const int*)texture->texels,
+      index,
+      pass,
+      sizeof(uint32_t));
+  } else {
+    // filtered texels are sampled one lane at a time
+    float us[SpanMaxLength];
+    float vs[SpanMaxLength];
+    uint32_t colors[SpanMaxLength];
+    _mm256_storeu_ps(us, u);
+    _mm256_storeu_ps(vs, v);
+    const int pass_mask = _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+    for (int lane = 0; lane < SpanMaxLength; ++lane) {
+      colors[lane] = (pass_mask & (1 << lane)) != 0
+                     ? texture->sample(texture, (tex2f_t){us[lane], vs[lane]})
+                     : 0;
+    }
+    texels = _mm256_loadu_si256((const __m256i*)colors);
+  }
+
+  _mm256_maskstore_epi32((int*)span->color_buffer, pass, texels);
+  _mm256_maskstore_ps(span->depth_buffer, pass, depth);
+}
+
+bool span_kernels_avx2(span_kernels_t* const kernels) {
+  *kernels = (span_kernels_t){
+    .name = "avx2",
+    .fill = span_fill_avx2,
+    .texture = span_texture_avx2,
+    .lane_count = SpanMaxLength};
+  return true;
+}
+
+#else
+
+bool span_kernels_avx2(span_kernels_t* const kernels) {
+  return false;
+}
+
+#endif
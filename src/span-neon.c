@@ -0,0 +1,242 @@
+#include "span.h"
+
+// vdivq_f32 is only available on AArch64 (ARMv7 would need an estimate)
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+#include <string.h>
+
+#define LaneCount 4
+
+// attribute for lanes [first, first + LaneCount)
+static float32x4_t lane_values(
+  const float value, const float step, const int first) {
+  const float lane_offsets[] = {0.0f, 1.0f, 2.0f, 3.0f};
+  const float32x4_t lanes =
+    vaddq_f32(vdupq_n_f32((float)first), vld1q_f32(lane_offsets));
+  return vaddq_f32(vdupq_n_f32(value), vmulq_f32(vdupq_n_f32(step), lanes));
+}
+
+static int32x4_t lane_weights(
+  const int weight, const int step, const int first) {
+  const int32_t lane_offsets[] = {0, 1, 2, 3};
+  const int32x4_t lanes =
+    vaddq_s32(vdupq_n_s32(first), vld1q_s32(lane_offsets));
+  return vaddq_s32(vdupq_n_s32(weight), vmulq_s32(vdupq_n_s32(step), lanes));
+}
+
+// lanes inside the span and inside all three edges
+static uint32x4_t lane_coverage(const span_t* const span, const int first) {
+  const int32x4_t weights = vorrq_s32(
+    lane_weights(span->weights[0], span->weight_steps[0], first),
+    vorrq_s32(
+      lane_weights(span->weights[1], span->weight_steps[1], first),
+      lane_weights(span->weights[2], span->weight_steps[2], first)));
+  const int32_t lane_offsets[] = {0, 1, 2, 3};
+  const int32x4_t lanes =
+    vaddq_s32(vdupq_n_s32(first), vld1q_s32(lane_offsets));
+  return vandq_u32(
+    vcgeq_s32(weights, vdupq_n_s32(0)),
+    vcltq_s32(lanes, vdupq_n_s32(span->length)));
+}
+
+// reduce wrapped lanes at least SpanWrapLimit from zero (or not finite) the
+// way the samplers in texture.c do, which is rare so done one lane at a time
+static float32x4_t reduce_wrapped_lanes(
+  const float32x4_t scaled, const int size) {
+  const uint32x4_t in_range =
+    vcltq_f32(vabsq_f32(scaled), vdupq_n_f32(SpanWrapLimit));
+  if (vminvq_u32(in_range) != 0) {
+    return scaled;
+  }
+  float lanes[LaneCount];
+  uint32_t lanes_in_range[LaneCount];
+  vst1q_f32(lanes, scaled);
+  vst1q_u32(lanes_in_range, in_range);
+  for (int lane = 0; lane < LaneCount; lane++) {
+    if (lanes_in_range[lane] == 0) {
+      lanes[lane] = reduce_wrapped_coordinate(lanes[lane], size);
+    }
+  }
+  return vld1q_f32(lanes);
+}
+
+// matches the nearest texel samplers in texture.c
+static int32x4_t texel_coordinates(
+  const float32x4_t t, const int size, const texture_address_e address) {
+  const int32x4_t last = vdupq_n_s32(size - 1);
+  float32x4_t scaled = vmulq_f32(t, vdupq_n_f32((float)size));
+  if (address == texture_address_clamp) {
+    // clamping before truncating matches flooring then clamping the texel
+    return vcvtq_s32_f32(vminq_f32(
+      vmaxq_f32(scaled, vdupq_n_f32(0.0f)), vdupq_n_f32((float)(size - 1))));
+  }
+  scaled = reduce_wrapped_lanes(scaled, size);
+  const int32x4_t texel = vcvtq_s32_f32(vrndmq_f32(scaled));
+  if ((size & (size - 1)) == 0) {
+    return vandq_s32(texel, last);
+  }
+  // estimate how many times the texture repeats then correct the remainder
+  // if the estimate is out by one
+  const int32x4_t size_i = vdupq_n_s32(size);
+  const int32x4_t repeats = vcvtq_s32_f32(vrndmq_f32(
+    vmulq_f32(vcvtq_f32_s32(texel), vdupq_n_f32(1.0f / (float)size))));
+  int32x4_t wrapped = vmlsq_s32(texel, repeats, size_i);
+  wrapped = vaddq_s32(
+    wrapped,
+    vandq_s32(
+      vreinterpretq_s32_u32(vcltq_s32(wrapped, vdupq_n_s32(0))), size_i));
+  return vsubq_s32(
+    wrapped,
+    vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(wrapped, last)), size_i));
+}
+
+// matches texel_index
+static int32x4_t texel_indices(
+  const texture_level_t* const texture, const int32x4_t x, const int32x4_t y) {
+  const int32x4_t mask = vdupq_n_s32(TextureTileMask);
+  const int32x4_t tile = vmlaq_s32(
+    vshrq_n_s32(x, TextureTileShift),
+    vshrq_n_s32(y, TextureTileShift),
+    vdupq_n_s32(texture->tile_columns));
+  return vorrq_s32(
+    vshlq_n_s32(tile, TextureTileShift * 2),
+    vorrq_s32(
+      vshlq_n_s32(vandq_s32(y, mask), TextureTileShift), vandq_s32(x, mask)));
+}
+
+// lanes past the end of the span are staged through local storage so loads
+// and stores never touch memory outside of the span
+typedef struct lane_buffers_t {
+  uint32_t* color_buffer;
+  float* depth_buffer;
+  uint32_t colors[LaneCount];
+  float depths[LaneCount];
+  int count;
+} lane_buffers_t;
+
+static void begin_lanes(
+  const span_t* const span, const int first, lane_buffers_t* const lanes) {
+  lanes->count = span->length - first;
+  if (lanes->count >= LaneCount) {
+    lanes->count = LaneCount;
+    lanes->color_buffer = span->color_buffer + first;
+    lanes->depth_buffer = span->depth_buffer + first;
+  } else {
+    memset(lanes->colors, 0, sizeof lanes->colors);
+    memset(lanes->depths, 0, sizeof lanes->depths);
+    memcpy(
+      lanes->colors,
+      span->color_buffer + first,
+      sizeof(uint32_t) * lanes->count);
+    memcpy(
+      lanes->depths, span->depth_buffer + first, sizeof(float) * lanes->count);
+    lanes->color_buffer = lanes->colors;
+    lanes->depth_buffer = lanes->depths;
+  }
+}
+
+static void end_lanes(
+  const span_t* const span, const int first, const lane_buffers_t* lanes) {
+  if (lanes->count < LaneCount) {
+    memcpy(
+      span->color_buffer + first,
+      lanes->colors,
+      sizeof(uint32_t) * lanes->count);
+    memcpy(
+      span->depth_buffer + first, lanes->depths, sizeof(float) * lanes->count);
+  }
+}
+
+static void span_fill_neon(
+  const span_t* const span, const void* const user_data) {
+  const uint32x4_t color = vdupq_n_u32(*(const uint32_t*)user_data);
+  for (int first = 0; first < span->length; first += LaneCount) {
+    lane_buffers_t lanes;
+    begin_lanes(span, first, &lanes);
+    const float32x4_t depth = lane_values(span->depth, span->depth_step, first);
+    const float32x4_t previous_depth = vld1q_f32(lanes.depth_buffer);
+    const uint32x4_t pass = vandq_u32(
+      lane_coverage(span, first), vcltq_f32(depth, previous_depth));
+    if (vmaxvq_u32(pass) != 0) {
+      vst1q_u32(
+        lanes.color_buffer,
+        vbslq_u32(pass, color, vld1q_u32(lanes.color_buffer)));
+      vst1q_f32(lanes.depth_buffer, vbslq_f32(pass, depth, previous_depth));
+      end_lanes(span, first, &lanes);
+    }
+  }
+}
+
+static void span_texture_neon(
+  const span_t* const span, const void* const user_data) {
+  const texture_level_t* texture = (const texture_level_t*)user_data;
+  for (int first = 0; first < span->length; first += LaneCount) {
+    lane_buffers_t lanes;
+    begin_lanes(span, first, &lanes);
+    const float32x4_t depth = lane_values(span->depth, span->depth_step, first);
+    const float32x4_t previous_depth = vld1q_f32(lanes.depth_buffer);
+    const uint32x4_t pass = vandq_u32(
+      lane_coverage(span, first), vcltq_f32(depth, previous_depth));
+    if (vmaxvq_u32(pass) == 0) {
+      continue;
+    }
+
+    // perspective correct uv
+    const float32x4_t w = vdivq_f32(
+      vdupq_n_f32(1.0f), lane_values(span->w_recip, span->w_recip_step, first));
+    const float32x4_t u = vmulq_f32(
+      lane_values(span->uv_over_w.u, span->uv_over_w_step.u, first), w);
+    const float32x4_t v = vmulq_f32(
+      lane_values(span->uv_over_w.v, span->uv_over_w_step.v, first), w);
+
+    uint32_t passes[LaneCount];
+    vst1q_u32(passes, pass);
+    // no gather instruction, fetch each passing lane individually
+    if (texture->filter == texture_filter_nearest) {
+      int32_t indices[LaneCount];
+      vst1q_s32(
+        indices,
+        texel_indices(
+          texture,
+          texel_coordinates(u, texture->width, texture->address),
+          texel_coordinates(v, texture->height, texture->address)));
+      for (int lane = 0; lane < LaneCount; ++lane) {
+        if (passes[lane] != 0) {
+          lanes.color_buffer[lane] = texture->texels[indices[lane]];
+        }
+      }
+    } else {
+      float us[LaneCount];
+      float vs[LaneCount];
+      vst1q_f32(us, u);
+      vst1q_f32(vs, v);
+      for (int lane = 0; lane < LaneCount; ++lane) {
+        if (passes[lane] != 0) {
+          lanes.color_buffer[lane] =
+            texture->sample(texture, (tex2f_t){us[lane], vs[lane]});
+        }
+      }
+    }
+    vst1q_f32(lanes.depth_buffer, vbslq_f32(pass, depth, previous_depth));
+    end_lanes(span, first, &lanes);
+  }
+}
+
+bool span_kernels_neon(span_kernels_t* const kernels) {
+  *kernels = (span_kernels_t){
+    .name = "neon",
+    .fill = span_fill_neon,
+    .texture = span_texture_neon,
+    .lane_count = LaneCount};
+  return true;
+}
+
+#else
+
+bool span_kernels_neon(span_kernels_t* const kernels) {
+  return false;
+}
+
+#endif
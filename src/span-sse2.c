@@ -0,0 +1,252 @@
+#include "span.h"
+
+#if defined(__SSE2__) || defined(_M_X64)                                       \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#include <string.h>
+
+#define LaneCount 4
+
+// attribute for lanes [first, first + LaneCount)
+static __m128 lane_values(
+  const float value, const float step, const int first) {
+  const __m128 lanes = _mm_add_ps(
+    _mm_set1_ps((float)first), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+  return _mm_add_ps(_mm_set1_ps(value), _mm_mul_ps(_mm_set1_ps(step), lanes));
+}
+
+static __m128i lane_weights(const int weight, const int step, const int first) {
+  const int lane_weight = weight + step * first;
+  return _mm_setr_epi32(
+    lane_weight,
+    lane_weight + step,
+    lane_weight + step * 2,
+    lane_weight + step * 3);
+}
+
+// lanes inside the span and inside all three edges
+static __m128i lane_coverage(const span_t* const span, const int first) {
+  const __m128i weights = _mm_or_si128(
+    lane_weights(span->weights[0], span->weight_steps[0], first),
+    _mm_or_si128(
+      lane_weights(span->weights[1], span->weight_steps[1], first),
+      lane_weights(span->weights[2], span->weight_steps[2], first)));
+  const __m128i lanes = _mm_add_epi32(
+    _mm_set1_epi32(first), _mm_setr_epi32(0, 1, 2, 3));
+  return _mm_and_si128(
+    _mm_cmpgt_epi32(weights, _mm_set1_epi32(-1)),
+    _mm_cmplt_epi32(lanes, _mm_set1_epi32(span->length)));
+}
+
+static __m128 select_ps(const __m128 mask, const __m128 a, const __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i select_si128(
+  const __m128i mask, const __m128i a, const __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// floor of each lane (truncate then subtract one where that rounded up)
+static __m128i floor_epi32(const __m128 value) {
+  const __m128i truncated = _mm_cvttps_epi32(value);
+  return _mm_add_epi32(
+    truncated,
+    _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), value)));
+}
+
+// reduce wrapped lanes at least SpanWrapLimit from zero (or not finite) the
+// way the samplers in texture.c do, which is rare so done one lane at a time
+static __m128 reduce_wrapped_lanes(__m128 scaled, const int size) {
+  const int in_range = _mm_movemask_ps(_mm_cmplt_ps(
+    _mm_andnot_ps(_mm_set1_ps(-0.0f), scaled), _mm_set1_ps(SpanWrapLimit)));
+  if (in_range == (1 << LaneCount) - 1) {
+    return scaled;
+  }
+  float lanes[LaneCount];
+  _mm_storeu_ps(lanes, scaled);
+  for (int lane = 0; lane < LaneCount; lane++) {
+    if ((in_range & (1 << lane)) == 0) {
+      lanes[lane] = reduce_wrapped_coordinate(lanes[lane], size);
+    }
+  }
+  return _mm_loadu_ps(lanes);
+}
+
+// matches the nearest texel samplers in texture.c
+static __m128i texel_coordinates(
+  const __m128 t, const int size, const texture_address_e address) {
+  const __m128 size_f = _mm_set1_ps((float)size);
+  __m128 scaled = _mm_mul_ps(t, size_f);
+  if (address == texture_address_clamp) {
+    // clamping before truncating matches flooring then clamping the texel
+    return _mm_cvttps_epi32(_mm_min_ps(
+      _mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps((float)(size - 1))));
+  }
+  scaled = reduce_wrapped_lanes(scaled, size);
+  const __m128i texel = floor_epi32(scaled);
+  const __m128i last = _mm_set1_epi32(size - 1);
+  if ((size & (size - 1)) == 0) {
+    return _mm_and_si128(texel, last);
+  }
+  // estimate how many times the texture repeats then correct the remainder
+  // if the estimate is out by one (there is no 32 bit multiply so it is
+  // found with floats, which are exact as the texels were reduced below
+  // SpanWrapLimit so every product and difference fits in 24 bits)
+  const __m128 texel_f = _mm_cvtepi32_ps(texel);
+  const __m128 repeats = _mm_cvtepi32_ps(
+    floor_epi32(_mm_mul_ps(texel_f, _mm_set1_ps(1.0f / (float)size))));
+  const __m128i size_i = _mm_set1_epi32(size);
+  __m128i wrapped =
+    _mm_cvttps_epi32(_mm_sub_ps(texel_f, _mm_mul_ps(repeats, size_f)));
+  wrapped = _mm_add_epi32(
+    wrapped,
+    _mm_and_si128(_mm_cmplt_epi32(wrapped, _mm_setzero_si128()), size_i));
+  return _mm_sub_epi32(
+    wrapped, _mm_and_si128(_mm_cmpgt_epi32(wrapped, last), size_i));
+}
+
+// lanes past the end of the span are staged through local storage so loads
+// and stores never touch memory outside of the span
+typedef struct lane_buffers_t {
+  uint32_t* color_buffer;
+  float* depth_buffer;
+  uint32_t colors[LaneCount];
+  float depths[LaneCount];
+  int count;
+} lane_buffers_t;
+
+static void begin_lanes(
+  const span_t* const span, const int first, lane_buffers_t* const lanes) {
+  lanes->count = span->length - first;
+  if (lanes->count >= LaneCount) {
+    lanes->count = LaneCount;
+    lanes->color_buffer = span->color_buffer + first;
+    lanes->depth_buffer = span->depth_buffer + first;
+  } else {
+    memset(lanes->colors, 0, sizeof lanes->colors);
+    memset(lanes->depths, 0, sizeof lanes->depths);
+    memcpy(
+      lanes->colors,
+      span->color_buffer + first,
+      sizeof(uint32_t) * lanes->count);
+    memcpy(
+      lanes->depths, span->depth_buffer + first, sizeof(float) * lanes->count);
+    lanes->color_buffer = lanes->colors;
+    lanes->depth_buffer = lanes->depths;
+  }
+}
+
+static void end_lanes(
+  const span_t* const span, const int first, const lane_buffers_t* lanes) {
+  if (lanes->count < LaneCount) {
+    memcpy(
+      span->color_buffer + first,
+      lanes->colors,
+      sizeof(uint32_t) * lanes->count);
+    memcpy(
+      span->depth_buffer + first, lanes->depths, sizeof(float) * lanes->count);
+  }
+}
+
+static void span_fill_sse2(
+  const span_t* const span, const void* const user_data) {
+  const __m128i color = _mm_set1_epi32(*(const int32_t*)user_data);
+  for (int first = 0; first < span->length; first += LaneCount) {
+    lane_buffers_t lanes;
+    begin_lanes(span, first, &lanes);
+    const __m128 depth = lane_values(span->depth, span->depth_step, first);
+    const __m128 previous_depth = _mm_loadu_ps(lanes.depth_buffer);
+    const __m128i pass = _mm_and_si128(
+      lane_coverage(span, first),
+      _mm_castps_si128(_mm_cmplt_ps(depth, previous_depth)));
+    if (_mm_movemask_ps(_mm_castsi128_ps(pass)) != 0) {
+      const __m128i previous_color =
+        _mm_loadu_si128((const __m128i*)lanes.color_buffer);
+      _mm_storeu_si128(
+        (__m128i*)lanes.color_buffer,
+        select_si128(pass, color, previous_color));
+      _mm_storeu_ps(
+        lanes.depth_buffer,
+        select_ps(_mm_castsi128_ps(pass), depth, previous_depth));
+      end_lanes(span, first, &lanes);
+    }
+  }
+}
+
+static void span_texture_sse2(
+  const span_t* const span, const void* const user_data) {
+  const texture_level_t* texture = (const texture_level_t*)user_data;
+  for (int first = 0; first < span->length; first += LaneCount) {
+    lane_buffers_t lanes;
+    begin_lanes(span, first, &lanes);
+    const __m128 depth = lane_values(span->depth, span->depth_step, first);
+    const __m128 previous_depth = _mm_loadu_ps(lanes.depth_buffer);
+    const __m128i pass = _mm_and_si128(
+      lane_coverage(span, first),
+      _mm_castps_si128(_mm_cmplt_ps(depth, previous_depth)));
+    const int pass_mask = _mm_movemask_ps(_mm_castsi128_ps(pass));
+    if (pass_mask == 0) {
+      continue;
+    }
+
+    // perspective correct uv
+    const __m128 w = _mm_div_ps(
+      _mm_set1_ps(1.0f),
+      lane_values(span->w_recip, span->w_recip_step, first));
+    const __m128 u = _mm_mul_ps(
+      lane_values(span->uv_over_w.u, span->uv_over_w_step.u, first), w);
+    const __m128 v = _mm_mul_ps(
+      lane_values(span->uv_over_w.v, span->uv_over_w_step.v, first), w);
+
+    // no gather instruction, fetch each passing lane individually
+    if (texture->filter == texture_filter_nearest) {
+      int32_t xs[LaneCount];
+      int32_t ys[LaneCount];
+      _mm_storeu_si128(
+        (__m128i*)xs, texel_coordinates(u, texture->width, texture->address));
+      _mm_storeu_si128(
+        (__m128i*)ys, texel_coordinates(v, texture->height, texture->address));
+      for (int lane = 0; lane < LaneCount; ++lane) {
+        if ((pass_mask & (1 << lane)) != 0) {
+          lanes.color_buffer[lane] =
+            texture->texels[texel_index(texture, xs[lane], ys[lane])];
+        }
+      }
+    } else {
+      float us[LaneCount];
+      float vs[LaneCount];
+      _mm_storeu_ps(us, u);
+      _mm_storeu_ps(vs, v);
+      for (int lane = 0; lane < LaneCount; ++lane) {
+        if ((pass_mask & (1 << lane)) != 0) {
+          lanes.color_buffer[lane] =
+            texture->sample(texture, (tex2f_t){us[lane], vs[lane]});
+        }
+      }
+    }
+    _mm_storeu_ps(
+      lanes.depth_buffer,
+      select_ps(_mm_castsi128_ps(pass), depth, previous_depth));
+    end_lanes(span, first, &lanes);
+  }
+}
+
+bool span_kernels_sse2(span_kernels_t* const kernels) {
+  *kernels = (span_kernels_t){
+    .name = "sse2",
+    .fill = span_fill_sse2,
+    .texture = span_texture_sse2,
+    .lane_count = LaneCount};
+  return true;
+}
+
+#else
+
+bool span_kernels_sse2(span_kernels_t* const kernels) {
+  return false;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "span.h"
+
+#include <SDL.h>
+
+#include <string.h>
+
+static bool span_covers(const span_t* const span, const int i) {
+  return ((span->weights[0] + span->weight_steps[0] * i)
+          | (span->weights[1] + span->weight_steps[1] * i)
+          | (span->weights[2] + span->weight_steps[2] * i))
+      >= 0;
+}
+
+static void span_fill_scalar(
+  const span_t* const span, const void* const user_data) {
+  const uint32_t color = *(const uint32_t*)user_data;
+  for (int i = 0; i < span->length; ++i) {
+    const float depth = span->depth + span->depth_step * (float)i;
+    if (span_covers(span, i) && depth < span->depth_buffer[i]) {
+      span->color_buffer[i] = color;
+      span->depth_buffer[i] = depth;
+    }
+  }
+}
+
+static void span_texture_scalar(
+  const span_t* const span, const void* const user_data) {
+  const texture_level_t* texture = (const texture_level_t*)user_data;
+  for (int i = 0; i < span->length; ++i) {
+    const float depth = span->depth + span->depth_step * (float)i;
+    if (span_covers(span, i) && depth < span->depth_buffer[i]) {
+      // perspective correct uv
+      const float w =
+        1.0f / (span->w_recip + span->w_recip_step * (float)i);
+      const tex2f_t uv = (tex2f_t){
+        .u = (span->uv_over_w.u + span->uv_over_w_step.u * (float)i) * w,
+        .v = (span->uv_over_w.v + span->uv_over_w_step.v * (float)i) * w};
+      span->color_buffer[i] = sample_texture(texture, uv);
+      span->depth_buffer[i] = depth;
+    }
+  }
+}
+
+static span_kernels_t span_kernels_scalar(void) {
+  return (span_kernels_t){
+    .name = "scalar",
+    .fill = span_fill_scalar,
+    .texture = span_texture_scalar,
+    .lane_count = 1};
+}
+
+span_kernels_t select_span_kernels(void) {
+  span_kernels_t kernels;
+  if (SDL_HasAVX2() && span_kernels_avx2(&kernels)) {
+    return kernels;
+  }
+  if (SDL_HasSSE2() && span_kernels_sse2(&kernels)) {
+    return kernels;
+  }
+  if (SDL_HasNEON() && span_kernels_neon(&kernels)) {
+    return kernels;
+  }
+  return span_kernels_scalar();
+}
+
+bool find_span_kernels(const char* const name, span_kernels_t* kernels) {
+  if (strcmp(name, "scalar") == 0) {
+    *kernels = span_kernels_scalar();
+    return true;
+  }
+  if (strcmp(name, "avx2") == 0) {
+    return SDL_HasAVX2() && span_kernels_avx2(kernels);
+  }
+  if (strcmp(name, "sse2") == 0) {
+    return SDL_HasSSE2() && span_kernels_sse2(kernels);
+  }
+  if (strcmp(name, "neon") == 0) {
+    return SDL_HasNEON() && span_kernels_neon(kernels);
+  }
+  return false;
+}
@@ -0,0 +1,55 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include "texture.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// maximum number of pixels in a span (one row of a screen tile)
+#define SpanMaxLength 8
+
+// wrapped texel coordinates at least this far from zero are reduced with
+// reduce_wrapped_coordinate before the simd kernels convert them (closer to
+// zero their float arithmetic is exact)
+#define SpanWrapLimit 8388608.0f // 2^23
+
+// a horizontal run of pixels within a single tile row, attributes are
+// evaluated at pixel i as value + step * i
+typedef struct span_t {
+  uint32_t* color_buffer; // color buffer at the first pixel
+  float* depth_buffer; // depth buffer at the first pixel
+  int length; // number of pixels (at most SpanMaxLength)
+  int weights[3]; // biased edge values at the first pixel (inside if >= 0)
+  int weight_steps[3];
+  float depth;
+  float depth_step;
+  float w_recip;
+  float w_recip_step;
+  tex2f_t uv_over_w;
+  tex2f_t uv_over_w_step;
+} span_t;
+
+// depth test and shade every covered pixel in the span
+typedef void (*span_fn_t)(const span_t* span, const void* user_data);
+
+typedef struct span_kernels_t {
+  const char* name;
+  span_fn_t fill; // user_data is a const uint32_t* color
+  span_fn_t texture; // user_data is a const texture_level_t*
+  // pixels shaded together (groups with none passing the depth test are
+  // skipped, but every pixel in a group that does is shaded)
+  int lane_count;
+} span_kernels_t;
+
+// fastest kernels supported by the cpu (detected at runtime)
+span_kernels_t select_span_kernels(void);
+// kernels by name (scalar, sse2, avx2 or neon), false if unsupported
+bool find_span_kernels(const char* name, span_kernels_t* kernels);
+
+// instruction set specific kernels (false if not built for this target)
+bool span_kernels_sse2(span_kernels_t* kernels);
+bool span_kernels_avx2(span_kernels_t* kernels);
+bool span_kernels_neon(span_kernels_t* kernels);
+
+#endif // SPAN_H
@@ -1,7 +1,10 @@
 #include "texture.h"
 
+#include <upng.h>
+
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 tex2f_t tex2f_mix(const tex2f_t begin, const tex2f_t end, const float t) {
   return (tex2f_t){
@@ -66,17 +69,276 @@ as_point2i point2i_at_proportion_of_size2i(
     (int)floorf((float)size.height * uv.v)};
 }
 
+uint32_t sample_texture(
+  const texture_level_t* const texture, const tex2f_t uv) {
+  return texture->sample(texture, uv);
+}
+
+float reduce_wrapped_coordinate(const float scaled, const int size) {
+  // fmodf is exact so the texel wrapped to is unchanged (infinities and nans
+  // have no texel, so use the first)
+  const float reduced = fmodf(scaled, (float)size);
+  return reduced == reduced ? reduced : 0.0f;
+}
+
+// wrapped coordinates at least this far from zero (in texels) are reduced
+// first so they convert to an int
+#define TextureWrapLimit 1073741824.0f // 2^30
+
+// texture coordinate scaled to texels (clamped coordinates are limited to
+// just outside the texture and large wrapped ones are reduced by the size,
+// so they always convert to an int)
+static inline float scale_coordinate(
+  const float t, const int size, const texture_address_e address) {
+  const float scaled = t * (float)size;
+  if (address == texture_address_clamp) {
+    return as_clamp_float(scaled, -1.0f, (float)size);
+  }
+  if (fabsf(scaled) < TextureWrapLimit) {
+    return scaled;
+  }
+  return reduce_wrapped_coordinate(scaled, size);
+}
+
+// floorf without the library call
+static inline int floor_to_int(const float value) {
+  const int truncated = (int)value;
+  return truncated - ((float)truncated > value ? 1 : 0);
+}
+
+// texel coordinate moved inside [0, size) (power of two sizes wrap with a
+// mask rather than a division)
+static inline int address_texel(
+  const int texel,
+  const int size,
+  const texture_address_e address,
+  const bool power_of_two) {
+  if (address == texture_address_clamp) {
+    return as_clamp_int(texel, 0, size - 1);
+  }
+  if (power_of_two) {
+    return texel & (size - 1);
+  }
+  const int wrapped = texel % size;
+  return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+static inline uint32_t sample_nearest(
+  const texture_level_t* const level,
+  const tex2f_t uv,
+  const texture_address_e address,
+  const bool power_of_two) {
+  const int x = address_texel(
+    floor_to_int(scale_coordinate(uv.u, level->width, address)),
+    level->width,
+    address,
+    power_of_two);
+  const int y = address_texel(
+    floor_to_int(scale_coordinate(uv.v, level->height, address)),
+    level->height,
+    address,
+    power_of_two);
+  return level->texels[texel_index(level, x, y)];
+}
+
+// blend of two colors (weight is in [0, 256], each 8 bit channel separately)
+static inline uint32_t mix_colors(
+  const uint32_t a, const uint32_t b, const uint32_t weight) {
+  const uint32_t mask = 0x00ff00ffu;
+  const uint32_t even =
+    (((a & mask) * (256 - weight) + (b & mask) * weight) >> 8) & mask;
+  const uint32_t odd =
+    (((a >> 8 & mask) * (256 - weight) + (b >> 8 & mask) * weight) >> 8)
+    & mask;
+  return even | odd << 8;
+}
+
+static inline uint32_t sample_bilinear(
+  const texture_level_t* const level,
+  const tex2f_t uv,
+  const texture_address_e address,
+  const bool power_of_two) {
+  // texel centers are half a texel in from their corners
+  const float s = scale_coordinate(uv.u, level->width, address) - 0.5f;
+  const float t = scale_coordinate(uv.v, level->height, address) - 0.5f;
+  const int x = floor_to_int(s);
+  const int y = floor_to_int(t);
+  const uint32_t weight_x = (uint32_t)((s - (float)x) * 256.0f);
+  const uint32_t weight_y = (uint32_t)((t - (float)y) * 256.0f);
+  const int x0 = address_texel(x, level->width, address, power_of_two);
+  const int x1 = address_texel(x + 1, level->width, address, power_of_two);
+  const int y0 = address_texel(y, level->height, address, power_of_two);
+  const int y1 = address_texel(y + 1, level->height, address, power_of_two);
+  const uint32_t* texels = level->texels;
+  return mix_colors(
+    mix_colors(
+      texels[texel_index(level, x0, y0)],
+      texels[texel_index(level, x1, y0)],
+      weight_x),
+    mix_colors(
+      texels[texel_index(level, x0, y1)],
+      texels[texel_index(level, x1, y1)],
+      weight_x),
+    weight_y);
+}
+
+// sampler for one combination of address mode, filter and size (the constant
+// arguments let the compiler drop every branch that does not apply)
+#define DefineTextureSampler(address, filter, size, power_of_two)              \
+  static uint32_t sample_##address##_##filter##_##size(                        \
+    const texture_level_t* const level, const tex2f_t uv) {                    \
+    return sample_##filter(                                                    \
+      level, uv, texture_address_##address, power_of_two);                     \
+  }
+
+DefineTextureSampler(wrap, nearest, any, false)
+DefineTextureSampler(wrap, nearest, pow2, true)
+DefineTextureSampler(wrap, bilinear, any, false)
+DefineTextureSampler(wrap, bilinear, pow2, true)
+DefineTextureSampler(clamp, nearest, any, false)
+DefineTextureSampler(clamp, nearest, pow2, true)
+DefineTextureSampler(clamp, bilinear, any, false)
+DefineTextureSampler(clamp, bilinear, pow2, true)
+
+// indexed by address mode, filter and whether the size is a power of two
+static const texture_sample_fn_t s_samplers[2][2][2] = {
+  [texture_address_wrap] =
+    {[texture_filter_nearest] =
+       {sample_wrap_nearest_any, sample_wrap_nearest_pow2},
+     [texture_filter_bilinear] =
+       {sample_wrap_bilinear_any, sample_wrap_bilinear_pow2}},
+  [texture_address_clamp] =
+    {[texture_filter_nearest] =
+       {sample_clamp_nearest_any, sample_clamp_nearest_pow2},
+     [texture_filter_bilinear] =
+       {sample_clamp_bilinear_any, sample_clamp_bilinear_pow2}}};
+
+static bool is_power_of_two(const int value) {
+  return value > 0 && (value & (value - 1)) == 0;
+}
+
+void set_texture_sampling(
+  texture_t* const texture,
+  const texture_address_e address,
+  const texture_filter_e filter) {
+  for (int l = 0; l < texture->level_count; ++l) {
+    texture_level_t* level = &texture->levels[l];
+    const bool power_of_two =
+      is_power_of_two(level->width) && is_power_of_two(level->height);
+    level->sample = s_samplers[address][filter][power_of_two];
+    level->address = address;
+    level->filter = filter;
+  }
+}
+
+// texels needed to store a level (padded to whole tiles)
+static size_t level_texel_count(const texture_level_t* const level) {
+  const int tile_rows = (level->height + TextureTileMask) >> TextureTileShift;
+  return (size_t)level->tile_columns * tile_rows * TextureTileSize
+       * TextureTileSize;
+}
+
+// average of four colors (each 8 bit channel is rounded separately)
+static uint32_t average_colors(
+  const uint32_t a, const uint32_t b, const uint32_t c, const uint32_t d) {
+  const uint32_t mask = 0x00ff00ffu;
+  const uint32_t round = 0x00020002u;
+  const uint32_t even =
+    (((a & mask) + (b & mask) + (c & mask) + (d & mask) + round) >> 2) & mask;
+  const uint32_t odd = (((a >> 8 & mask) + (b >> 8 & mask) + (c >> 8 & mask)
+                         + (d >> 8 & mask) + round)
+                        >> 2)
+                     & mask;
+  return even | odd << 8;
+}
+
+// box filter each 2x2 block of source texels into one level texel (the last
+// row/column of an odd sized source is repeated)
+static void downsample_level(
+  const texture_level_t* const source, const texture_level_t* const level) {
+  for (int y = 0; y < level->height; ++y) {
+    const int y0 = y * 2;
+    const int y1 = as_min_int(y0 + 1, source->height - 1);
+    for (int x = 0; x < level->width; ++x) {
+      const int x0 = x * 2;
+      const int x1 = as_min_int(x0 + 1, source->width - 1);
+      level->texels[texel_index(level, x, y)] = average_colors(
+        source->texels[texel_index(source, x0, y0)],
+        source->texels[texel_index(source, x1, y0)],
+        source->texels[texel_index(source, x0, y1)],
+        source->texels[texel_index(source, x1, y1)]);
+    }
+  }
+}
+
+// copy row-major pixels (top row first) into the tiles of the first level
+// (bottom row first) and filter every smaller level from the one before it,
+// the texels padding partial tiles are left clear
+static texture_t create_mipmapped_texture(
+  const uint32_t* const pixels, const int width, const int height) {
+  texture_t texture = {0};
+  size_t texel_count = 0;
+  for (int w = width, h = height; texture.level_count < TextureMaxLevels;
+       w = as_max_int(w / 2, 1), h = as_max_int(h / 2, 1)) {
+    texture_level_t* level = &texture.levels[texture.level_count++];
+    *level = (texture_level_t){
+      .width = w,
+      .height = h,
+      .tile_columns = (w + TextureTileMask) >> TextureTileShift};
+    texel_count += level_texel_count(level);
+    if (w == 1 && h == 1) {
+      break;
+    }
+  }
+
+  // over allocated to align (malloc only guarantees 16 bytes or less)
+  texture.allocation =
+    calloc(texel_count * sizeof(uint32_t) + TextureAlignment - 1, 1);
+  if (texture.allocation == NULL) {
+    return (texture_t){0};
+  }
+  texture.texels = (uint32_t*)(((uintptr_t)texture.allocation
+                                + TextureAlignment - 1)
+                               & ~(uintptr_t)(TextureAlignment - 1));
+  // levels follow each other, each a whole number of 64 byte tiles, so every
+  // level starts on a cache line as the texels do
+  uint32_t* texels = texture.texels;
+  for (int l = 0; l < texture.level_count; ++l) {
+    texture.levels[l].texels = texels;
+    texels += level_texel_count(&texture.levels[l]);
+  }
+
+  const texture_level_t* base = &texture.levels[0];
+  for (int y = 0; y < height; ++y) {
+    const uint32_t* row = pixels + (size_t)(height - 1 - y) * width;
+    for (int x = 0; x < width; ++x) {
+      base->texels[texel_index(base, x, y)] = row[x];
+    }
+  }
+  for (int l = 1; l < texture.level_count; ++l) {
+    downsample_level(&texture.levels[l - 1], &texture.levels[l]);
+  }
+  set_texture_sampling(&texture, texture_address_wrap, texture_filter_nearest);
+  return texture;
+}
+
 texture_t load_png_texture(const char* filename) {
-  upng_t* texture = upng_new_from_file(filename);
-  if (texture != NULL) {
-    upng_decode(texture);
-    if (upng_get_error(texture) == UPNG_EOK) {
-      return (texture_t){
-        .png_texture = texture,
-        .color_buffer = (uint32_t*)upng_get_buffer(texture),
-        .width = (int)upng_get_width(texture),
-        .height = (int)upng_get_height(texture)};
+  texture_t texture = {0};
+  upng_t* png = upng_new_from_file(filename);
+  if (png != NULL) {
+    upng_decode(png);
+    if (upng_get_error(png) == UPNG_EOK) {
+      texture = create_mipmapped_texture(
+        (const uint32_t*)upng_get_buffer(png),
+        (int)upng_get_width(png),
+        (int)upng_get_height(png));
     }
+    upng_free(png);
   }
-  return (texture_t){0};
+  return texture;
+}
+
+void destroy_texture(texture_t* const texture) {
+  free(texture->allocation);
+  *texture = (texture_t){0};
 }
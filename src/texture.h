@@ -2,8 +2,8 @@
 #define TEXTURE_H
 
 #include <as-ops.h>
+#include <stdbool.h>
 #include <stdint.h>
-#include <upng.h>
 
 struct projected_triangle_t;
 
@@ -18,13 +18,63 @@ typedef struct barycentric_coords_t {
   float gamma;
 } barycentric_coords_t;
 
-typedef struct texture_t {
-  upng_t* png_texture;
-  uint32_t* color_buffer;
+// texels are stored in square tiles of TextureTileSize x TextureTileSize
+// texels so texels close in uv are close in memory whatever the direction a
+// triangle is drawn in (a tile is 64 bytes and texels are allocated on a
+// TextureAlignment boundary, so each tile is exactly one cache line)
+#define TextureTileShift 2
+#define TextureTileSize (1 << TextureTileShift)
+#define TextureTileMask (TextureTileSize - 1)
+#define TextureAlignment 64
+// enough mip levels for a 32768x32768 texture
+#define TextureMaxLevels 16
+
+typedef enum texture_address_e {
+  texture_address_wrap, // uvs repeat outside [0, 1)
+  texture_address_clamp // uvs outside [0, 1] use the edge texels
+} texture_address_e;
+
+typedef enum texture_filter_e {
+  texture_filter_nearest,
+  texture_filter_bilinear // blend the four texels nearest the uv
+} texture_filter_e;
+
+struct texture_level_t;
+
+// color of a texture level at uv
+typedef uint32_t (*texture_sample_fn_t)(
+  const struct texture_level_t* level, tex2f_t uv);
+
+typedef struct texture_level_t {
+  uint32_t* texels; // tiles in row order, rows run from v = 0 (bottom) up
   int width;
   int height;
+  int tile_columns; // tiles in each row of tiles
+  // sampler specialized for the address mode, filter and (power of two or
+  // arbitrary) size of the level
+  texture_sample_fn_t sample;
+  texture_address_e address;
+  texture_filter_e filter;
+} texture_level_t;
+
+typedef struct texture_t {
+  // levels[0] is the full image and every level after it is box filtered to
+  // half the size of the one before, down to 1x1
+  texture_level_t levels[TextureMaxLevels];
+  int level_count;
+  uint32_t* texels; // every level (aligned to TextureAlignment)
+  void* allocation; // texels before they were aligned
 } texture_t;
 
+// position of texel (x, y) (y is measured from the bottom of the image)
+static inline int texel_index(
+  const texture_level_t* const level, const int x, const int y) {
+  const int tile =
+    (y >> TextureTileShift) * level->tile_columns + (x >> TextureTileShift);
+  return (tile << (TextureTileShift * 2))
+       | ((y & TextureTileMask) << TextureTileShift) | (x & TextureTileMask);
+}
+
 tex2f_t tex2f_mix(tex2f_t begin, tex2f_t end, float t);
 tex2f_t tex2f_div_scalar(tex2f_t tex, float scale);
 
@@ -43,6 +93,19 @@ tex2f_t calculate_uv(
   tex2f_t uv2,
   float w2);
 
+// wrapped texel coordinate (a texture coordinate scaled by the size) moved
+// between -size and size without changing the texel it wraps to
+float reduce_wrapped_coordinate(float scaled, int size);
+
+// color at uv using the sampler picked for the level
+uint32_t sample_texture(const texture_level_t* texture, tex2f_t uv);
+
+// decodes the png, converts it to the tiled layout and builds its mip levels
+// (sampled with wrapping and the nearest filter until changed)
 texture_t load_png_texture(const char* filename);
+// pick the samplers every level of the texture uses
+void set_texture_sampling(
+  texture_t* texture, texture_address_e address, texture_filter_e filter);
+void destroy_texture(texture_t* texture);
 
 #endif // TEXTURE_H